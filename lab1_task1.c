@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,37 +8,399 @@
 #include <sys/wait.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <termios.h>
+#include <dirent.h>
+#include <limits.h>
 
-#define MAX_COMMAND_LENGTH 30
 #define MAX_COMMANDS_IN_HISTORY 10
-#define PROMPT() printf("SamSh>")
+#define HISTORY_FILE_NAME ".samsh_history"
+#define COPROCESS_TIMEOUT_MS 5000
+#define COPY_CHUNK_SIZE (1 << 20)
+#define INITIAL_HASH_CAPACITY 64
+#define PROCESS_RUNNING 0
+#define PROCESS_STOPPED 1
+#define PROCESS_DONE 2
+#define COMPLETION_LIST_LIMIT 200
+#define PROMPT_TEXT "SamSh>"
+#define PROMPT() if (interactive) printf(PROMPT_TEXT)
 #define HELP() printf("-----------------------------------\
 \nThis is a shell that executes commands in a child process.\n\n"\
-"Usage:\n\t[command] [arguments] [&] \n\n" \
-"\t&\n\t\tRun the command concurrently\n-----------------------------------\n")
+"Usage:\n\t[main.c] [-F] [-T] [-j jobs] [scriptfile | -]\n\n" \
+"\t-F\n\t\tAlways start commands with fork and exec instead of posix_spawn\n" \
+"\t-T\n\t\tTime every command like the time prefix does\n" \
+"\t-j jobs\n\t\tRun at most this many commands concurrently with &\n" \
+"\tscriptfile | -\n\t\tRun the commands of a file, or of stdin with -, without prompting, and print the wall time\n" \
+"\t\tand the CPU time of the commands at the end\n\n" \
+"\tThe history is kept in $SAMSH_HISTORY, or ~/" HISTORY_FILE_NAME ", and the commands of an interactive shell are\n" \
+"\tappended to it at exit\n\n" \
+"Commands:\n\t[command] [arguments] [< file] [| command [arguments]].. [> file | >> file] [&] \n\n" \
+"\t|\n\t\tPipe the output of a command into the next command\n" \
+"\t< file\n\t\tRead the input of a command from a file\n" \
+"\t> file\n\t\tWrite the output of a command to a file\n" \
+"\t>> file\n\t\tAppend the output of a command to a file\n" \
+"\t&\n\t\tRun the command concurrently as a job\n" \
+"\t'...', \"...\", \\\n\t\tQuote text with spaces or operators in it, and escape a single character\n" \
+"\ttime command\n\t\tPrint the wall, user and sys time, max RSS and voluntary/involuntary context switches of\n" \
+"\t\teach command of the pipeline and of the whole pipeline to stderr when it finishes\n\n" \
+"\tjobs\n\t\tList the jobs, with the exit status and CPU time of finished jobs\n" \
+"\tfg [%job]\n\t\tContinue a job, or the most recent job, and wait for it\n" \
+"\tbg [%job]\n\t\tContinue a stopped job, or the most recent job, concurrently\n" \
+"\twait [%job]\n\t\tWait for a job, or for every job running concurrently\n" \
+"\thistory\n\t\tList the 10 most recent commands\n" \
+"\thistory -t\n\t\tList the 10 most recent commands with their resource usage, and the totals of all commands\n" \
+"\thistory -s text\n\t\tList every command in the history containing the text\n" \
+"\t!!, !N, !prefix\n\t\tRun the most recent command, command number N, or the most recent command starting with prefix\n" \
+"\thash\n\t\tList the remembered paths of commands and the hits and misses of the lookups\n" \
+"\thash -r\n\t\tForget the remembered paths of commands\n" \
+"\tcoproc command [arguments]\n\t\tStart a command as a coprocess, which keeps running for later requests\n" \
+"\tcoproc -s line\n\t\tSend a line to the coprocess and print its response line\n" \
+"\tcoproc -f file\n\t\tStream the lines of a file to the coprocess and print a response line for each\n" \
+"\tcoproc -k\n\t\tClose the input of the coprocess, print the rest of its output and wait for it\n" \
+"\tcoproc\n\t\tPrint the coprocess\n\n" \
+"\tOn a terminal the line can be edited with the arrow keys, Home, End, Delete, Ctrl-A/E/B/F/K/U/W, and\n" \
+"\tUp/Down or Ctrl-P/N go through the history. Tab completes commands from PATH and file names, and a\n" \
+"\tsecond Tab lists the completions\n\n" \
+"\tcat without options is done by the shell, which moves the data between files and pipes in the kernel\n" \
+"-----------------------------------\n")
+
+/* A command of a pipeline. The arguments point to the tokens of the parsed command. */
+typedef struct {
+    char **arguments;
+    char *inputFile;
+    char *outputFile;
+    bool appendOutput;
+} PipelineStage;
+
+typedef struct {
+    PipelineStage *stages;
+    int stageCount;
+} Pipeline;
+
+/* A command name and the absolute path it was found at in PATH. The path is NULL when the command has to be
+ * looked up again. */
+typedef struct {
+    char *name;
+    char *path;
+    long hits;
+} CommandHashEntry;
+
+/* Hash table with linear probing from command names to their paths, valid for the PATH it was filled
+ * from. */
+typedef struct {
+    CommandHashEntry *entries;
+    size_t capacity;
+    size_t count;
+    char *searchPath;
+    long hits;
+    long misses;
+} CommandHashTable;
+
+/* Resources used by commands. The max RSS is the largest of the commands, the rest is added up. */
+typedef struct {
+    double wallSeconds;
+    struct timeval userTime;
+    struct timeval systemTime;
+    long maxResidentKilobytes;
+    long voluntarySwitches;
+    long involuntarySwitches;
+} ResourceUsage;
+
+/* A command that keeps running while the shell sends it lines through a pipe to its input and reads its
+ * responses through a pipe from its output, so it only starts once for many requests. Output that is not
+ * a whole line yet stays in the buffer. */
+typedef struct {
+    pid_t pid;
+    char *command;
+    int inputDescriptor;
+    int outputDescriptor;
+    char *buffer;
+    size_t bufferLength;
+    size_t bufferCapacity;
+    long linesSent;
+    long linesReceived;
+} Coprocess;
+
+/* The arguments of the command being done. The array is reused for every command and only grows. */
+typedef struct {
+    char **arguments;
+    size_t capacity;
+} ArgumentArena;
+
+/* The processes of a pipeline started by the shell. The SIGCHLD handler reaps them with wait4 on their pids
+ * and records their states, the exit status of the last process and the resource usage of each of them and
+ * of the pipeline, whose wall time ends with its last process. The job table itself is only changed by the
+ * shell while SIGCHLD is blocked. */
+typedef struct {
+    int number;
+    char *command;
+    pid_t processGroup;
+    pid_t *pids;
+    int *processStates;
+    int processCount;
+    int runningCount;
+    int stoppedCount;
+    int stopSignal;
+    int exitStatus;
+    struct timespec startTime;
+    char **processNames;
+    ResourceUsage *processUsages;
+    ResourceUsage usage;
+    size_t historyIndex;
+    bool timed;
+    bool foreground;
+} Job;
+
+typedef struct {
+    Job *jobs;
+    int count;
+    int capacity;
+} JobTable;
+
+/* Every command issued, numbered from 1. The commands of earlier sessions are the lines of the history
+ * file, which is mapped at startup and indexed the first time the history is used. The commands of this
+ * session are appended to a log with a newline after each, so the log is written to the file as it is. Both
+ * are indexed by the offsets where their commands start. The commands of this session also have the
+ * resource usage of their job, with a negative wall time until it has finished. */
+typedef struct {
+    char *fileName;
+    char *mapping;
+    size_t mappingSize;
+    size_t *fileOffsets;
+    size_t fileCount;
+    bool fileIndexed;
+    char *log;
+    size_t logLength;
+    size_t logCapacity;
+    size_t *logOffsets;
+    ResourceUsage *logUsages;
+    size_t logCount;
+    size_t logOffsetsCapacity;
+} CommandHistory;
+
+/* A line being edited in raw mode, with the cursor as an offset into it. The command of the history being
+ * shown is counted back from the most recent one, with 0 for the line being typed, which is kept while the
+ * history is browsed. */
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+    size_t cursor;
+    size_t historyOffset;
+    char *typedLine;
+} LineEditor;
+
+/* A node of a prefix trie. The nodes of a trie are kept in one array, with the root first, and link to
+ * their first child and next sibling by index. Each node counts the names that end in or below it. */
+typedef struct {
+    char label;
+    bool terminal;
+    int firstChild;
+    int nextSibling;
+    int nameCount;
+} TrieNode;
+
+typedef struct {
+    TrieNode *nodes;
+    int count;
+    int capacity;
+} Trie;
+
+/* The executables of a directory of PATH. The directory is read into its trie when a command is first
+ * completed, and again when its modification time has changed. */
+typedef struct {
+    char *path;
+    struct timespec modificationTime;
+    bool loaded;
+    Trie trie;
+} CompletionDirectory;
 
-void printCommandHistory(char history[MAX_COMMANDS_IN_HISTORY][MAX_COMMAND_LENGTH], int commandCounter, int historyIndex);
+typedef struct {
+    CompletionDirectory *directories;
+    size_t count;
+    size_t capacity;
+} CompletionCache;
+
+typedef struct {
+    char **names;
+    size_t count;
+    size_t capacity;
+} CompletionList;
+
+bool alwaysFork = false;
+bool timeCommands = false;
+bool interactive = true;
+bool jobControl = false;
+bool lineEditing = false;
+int jobLimit = 0;
+CommandHashTable commandHashTable = { NULL, 0, 0, NULL, 0, 0 };
+JobTable jobTable = { NULL, 0, 0 };
+CommandHistory commandHistory;
+ArgumentArena argumentArena = { NULL, 0 };
+CompletionCache completionCache = { NULL, 0, 0 };
+Coprocess coprocess = { 0, NULL, -1, -1, NULL, 0, 0, 0, 0 };
+char *const shellOperators[] = { "|", "<", ">", "&", ">>" };
+ResourceUsage commandTotals;
+long finishedJobCount = 0;
+sigset_t childSignalMask;
+sigset_t unblockedSignalMask;
+
+void openHistory(void);
+void indexHistoryFile(void);
+size_t countHistory(void);
+const char *getHistoryEntry(size_t number, size_t *length);
+void addToHistory(const char *command);
+size_t findHistoryByPrefix(const char *prefix);
+void runHistoryEntry(size_t number);
+void printCommandHistory(void);
+void printCommandHistoryUsage(void);
+void searchCommandHistory(const char *text);
+void saveHistory(void);
 void doCommand(char command[]);
 char **parseCommand(char input[]);
-int executeCommandInChildProcess(char *command[]);
-void freeCommand(char **executedCommand);
-void incrementIndex(int *historyIndex, int *commandCounter);
+char *readOperator(char first, char *rest, char **token);
+bool isOperator(const char *token, const char *operator);
+int executeCommandInChildProcess(char *command[], bool timed);
+bool parsePipeline(char *command[], Pipeline *pipeline);
+void freePipeline(Pipeline *pipeline);
+pid_t startPipelineStage(PipelineStage *stage, int inputDescriptor, int outputDescriptor, int unusedDescriptor,
+                         pid_t processGroup);
+int spawnPipelineStage(PipelineStage *stage, char *commandPath, int inputDescriptor, int outputDescriptor,
+                       int unusedDescriptor, pid_t processGroup, pid_t *pid);
+void redirectStage(PipelineStage *stage);
+bool isPlainCat(char **arguments);
+int catFiles(char **filenames);
+bool copyFileDescriptor(int from, int to);
+char *findCommand(char *name);
+CommandHashEntry *findCommandEntry(char *name);
+void growCommandHashTable(void);
+char *searchCommandPath(const char *searchPath, const char *name);
+void forgetCommand(char *name);
+void clearCommandHashTable(void);
+void printCommandHashTable(void);
+uint64_t hashCommandName(const char *name);
+void installJobControl(void);
+void reapJobProcesses(int signalNumber);
+Job *addJob(pid_t *pids, int processCount, pid_t processGroup, char *command, bool foreground);
+char *joinCommand(char **command);
+Job *findJob(char *specification);
+void resumeJob(char *specification, bool foreground);
+void continueJob(Job *job);
+void giveTerminalTo(pid_t processGroup);
+int waitForForegroundJob(Job *job);
+void waitForJobs(char *specification);
+void waitForAllJobs(void);
+int countRunningJobs(void);
+void printJobs(void);
+void printJob(Job *job);
+void removeFinishedJobs(bool report);
+void removeJob(int index);
+void addResourceUsage(ResourceUsage *total, const ResourceUsage *usage);
+void printResourceUsage(FILE *stream, const ResourceUsage *usage, const char *name);
+void printJobUsage(Job *job);
+void doCoprocessCommand(char *arguments);
+void startCoprocess(char *commandLine);
+bool isCoprocessRunning(void);
+bool streamToCoprocess(const char *lines, size_t length, long lineCount);
+void streamFileToCoprocess(const char *filename);
+ssize_t readFromCoprocess(long maxLines);
+void finishCoprocess(void);
+void closeCoprocess(void);
+long countLines(const char *text, size_t length);
+ssize_t readEditedLine(char **line, size_t *capacity);
+void readEscapeSequence(LineEditor *editor);
+void refreshEditedLine(LineEditor *editor);
+void reserveEditorSpace(LineEditor *editor, size_t extra);
+void insertEditorText(LineEditor *editor, const char *text, size_t length);
+void deleteEditorText(LineEditor *editor, size_t start, size_t length);
+void browseHistory(LineEditor *editor, int steps);
+void completeWord(LineEditor *editor, bool listCompletions);
+size_t completeCommand(const char *prefix, CompletionList *completions, char **common);
+size_t completeFileName(const char *word, CompletionList *completions, char **common);
+CompletionDirectory **refreshCompletionDirectories(void);
+CompletionDirectory *findCompletionDirectory(const char *path);
+void loadCompletionDirectory(CompletionDirectory *directory);
+int addTrieNode(Trie *trie, char label);
+void addToTrie(Trie *trie, const char *name);
+int findTrieNode(Trie *trie, const char *prefix);
+void collectTrieNames(Trie *trie, int node, char *name, size_t length, CompletionList *completions);
+size_t extendTriePrefix(Trie *trie, int node, char *name, size_t length);
+void addCompletion(CompletionList *completions, const char *name);
+size_t finishCompletions(CompletionList *completions, const char *word, char **common);
+int compareNames(const void *first, const void *second);
+void freeCompletions(CompletionList *completions);
+void finishScript(struct timespec *startTime);
 
 /**
  * Shell for executing commands in a child process.
  *
+ * @param argc Arguments count
+ * @param argv Arguments
  * @return exit code
  */
-int main(void)
+int main(int argc, char **argv)
 {
-    char input[MAX_COMMAND_LENGTH];
-    char history[MAX_COMMANDS_IN_HISTORY][MAX_COMMAND_LENGTH];
-    int historyIndex = 0;
-    int commandCounter = 0;
+    int option;
+    while ((option = getopt(argc, argv, "FTj:")) != -1) {
+        if (option == 'F') {
+            alwaysFork = true;
+        } else if (option == 'T') {
+            timeCommands = true;
+        } else if (option == 'j') {
+            jobLimit = atoi(optarg);
+            if (jobLimit < 1) {
+                printf("%s is not a valid amount of jobs, exiting..\n", optarg);
+                return 1;
+            }
+        } else {
+            HELP();
+            return 1;
+        }
+    }
+
+    FILE *inputFile = stdin;
+    if (optind < argc) {
+        interactive = false;
+        if (strcmp(argv[optind], "-") != 0) {
+            inputFile = fopen(argv[optind], "r");
+            if (inputFile == NULL) {
+                printf("Error opening script. Exiting..");
+                return 1;
+            }
+        }
+    }
+
+    installJobControl();
+    openHistory();
+    lineEditing = interactive && isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    char *input = NULL;
+    size_t inputCapacity = 0;
 
     while (true) {
+        removeFinishedJobs(interactive);
         PROMPT();
-        if (fgets(input, sizeof(input), stdin) == NULL) {
+        sigprocmask(SIG_SETMASK, &unblockedSignalMask, NULL);
+        ssize_t lineLength = lineEditing ? readEditedLine(&input, &inputCapacity)
+                                         : getline(&input, &inputCapacity, inputFile);
+        sigprocmask(SIG_BLOCK, &childSignalMask, NULL);
+        if (lineLength < 0) {
+            saveHistory();
+            if (!interactive) {
+                finishScript(&startTime);
+            }
             printf("invalid input, exiting..");
             exit(EXIT_FAILURE);
         } else if (*input == '\n' || input[0] == ' ') {
@@ -49,171 +413,2832 @@ int main(void)
             HELP();
         }
         else if (strcmp("exit", input) == 0) {
+            saveHistory();
+            if (!interactive) {
+                finishScript(&startTime);
+            }
             printf("Exiting..");
             exit(EXIT_SUCCESS);
         }
+        else if (strcmp("jobs", input) == 0) {
+            printJobs();
+        }
+        else if (strncmp("fg", input, 2) == 0 && (input[2] == '\0' || input[2] == ' ')) {
+            resumeJob(input + 2, true);
+        }
+        else if (strncmp("bg", input, 2) == 0 && (input[2] == '\0' || input[2] == ' ')) {
+            resumeJob(input + 2, false);
+        }
+        else if (strncmp("wait", input, 4) == 0 && (input[4] == '\0' || input[4] == ' ')) {
+            waitForJobs(input + 4);
+        }
         else if (strcmp("history", input) == 0) {
-            printCommandHistory(history, commandCounter, historyIndex);
+            printCommandHistory();
+        }
+        else if (strcmp("history -t", input) == 0) {
+            printCommandHistoryUsage();
+        }
+        else if (strncmp("history -s ", input, 11) == 0) {
+            searchCommandHistory(input + 11);
+        }
+        else if (strcmp("hash", input) == 0) {
+            printCommandHashTable();
+        }
+        else if (strcmp("hash -r", input) == 0) {
+            clearCommandHashTable();
+        }
+        else if (strncmp("coproc", input, 6) == 0 && (input[6] == '\0' || input[6] == ' ')) {
+            doCoprocessCommand(input + 6);
         }
         else if (input[0] == '!') {
+            size_t number = 0;
             if (strcmp("!!", input) == 0) {
-                if (commandCounter > 0) {
-                    PROMPT();
-                    printf("%s\n", history[historyIndex - 1]);
-                    strcpy(history[historyIndex], history[historyIndex - 1]);
-                    doCommand(history[historyIndex - 1]);
-                    incrementIndex(&historyIndex, &commandCounter);
-                }
-            } else if (isdigit(input[1]) && input[1] != '0' && strlen(input) == 2) {
-                int requestedHistoryIndex = (input[1] - '0') - 1;
-                if (strcmp(history[requestedHistoryIndex], "") == 0) {
-                    printf("No such command in history.\n");
-                } else {
-                    PROMPT();
-                    printf("%s\n", history[requestedHistoryIndex]);
-                    strcpy(history[historyIndex], history[requestedHistoryIndex]);
-                    doCommand(history[requestedHistoryIndex]);
-                    incrementIndex(&historyIndex, &commandCounter);
-                }
+                number = countHistory();
+            } else if (isdigit(input[1])) {
+                char *end;
+                number = strtoul(input + 1, &end, 10);
+                number = *end == '\0' ? number : 0;
+            } else if (input[1] != '\0') {
+                number = findHistoryByPrefix(input + 1);
+            }
+
+            if (number == 0 || number > countHistory()) {
+                printf("No such command in history.\n");
+            } else {
+                runHistoryEntry(number);
             }
         }
         else {
-            strcpy(history[historyIndex], input);
+            addToHistory(input);
             doCommand(input);
-            incrementIndex(&historyIndex, &commandCounter);
         }
     }
 }
 
 /**
- * Print the 10 most recent commands to the console.
+ * Map the history file, which is $SAMSH_HISTORY or the history file in the home directory. The file is only
+ * read when the history is first used.
+ */
+void openHistory(void)
+{
+    const char *fileName = getenv("SAMSH_HISTORY");
+    if (fileName != NULL) {
+        commandHistory.fileName = strdup(fileName);
+    } else if (getenv("HOME") != NULL) {
+        commandHistory.fileName = malloc(strlen(getenv("HOME")) + strlen(HISTORY_FILE_NAME) + 2);
+        if (commandHistory.fileName != NULL) {
+            sprintf(commandHistory.fileName, "%s/%s", getenv("HOME"), HISTORY_FILE_NAME);
+        }
+    }
+    if (commandHistory.fileName == NULL) {
+        return;
+    }
+
+    int fileDescriptor = open(commandHistory.fileName, O_RDONLY);
+    struct stat fileStatus;
+    if (fileDescriptor < 0) {
+        return;
+    }
+    if (fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size > 0) {
+        void *mapping = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (mapping != MAP_FAILED) {
+            commandHistory.mapping = mapping;
+            commandHistory.mappingSize = fileStatus.st_size;
+        }
+    }
+    close(fileDescriptor);
+}
+
+/**
+ * Index the lines of the mapped history file, unless they already are. Empty lines are skipped.
+ */
+void indexHistoryFile(void)
+{
+    if (commandHistory.fileIndexed) {
+        return;
+    }
+    commandHistory.fileIndexed = true;
+
+    size_t capacity = 0;
+    size_t offset = 0;
+    while (offset < commandHistory.mappingSize) {
+        char *lineEnd = memchr(commandHistory.mapping + offset, '\n', commandHistory.mappingSize - offset);
+        size_t nextOffset = lineEnd != NULL ? (size_t) (lineEnd - commandHistory.mapping) + 1
+                                            : commandHistory.mappingSize;
+        if (nextOffset - offset > 1 || lineEnd == NULL) {
+            if (commandHistory.fileCount == capacity) {
+                capacity = capacity == 0 ? 1024 : capacity * 2;
+                commandHistory.fileOffsets = realloc(commandHistory.fileOffsets, capacity * sizeof(size_t));
+                if (commandHistory.fileOffsets == NULL) {
+                    printf("Error: realloc failed in indexHistoryFile\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            commandHistory.fileOffsets[commandHistory.fileCount++] = offset;
+        }
+        offset = nextOffset;
+    }
+}
+
+/**
+ * Count the commands in the history.
+ *
+ * @return The amount of commands
+ */
+size_t countHistory(void)
+{
+    indexHistoryFile();
+
+    return commandHistory.fileCount + commandHistory.logCount;
+}
+
+/**
+ * Get a command of the history. The command is not terminated.
+ *
+ * @param number The number of the command, from 1 to the amount of commands
+ * @param length Pointer to the length of the command
+ * @return The command
+ */
+const char *getHistoryEntry(size_t number, size_t *length)
+{
+    indexHistoryFile();
+
+    const char *entry;
+    const char *end;
+    if (number <= commandHistory.fileCount) {
+        entry = commandHistory.mapping + commandHistory.fileOffsets[number - 1];
+        end = memchr(entry, '\n', commandHistory.mapping + commandHistory.mappingSize - entry);
+        if (end == NULL) {
+            end = commandHistory.mapping + commandHistory.mappingSize;
+        }
+    } else {
+        size_t index = number - commandHistory.fileCount - 1;
+        entry = commandHistory.log + commandHistory.logOffsets[index];
+        end = commandHistory.log + (index + 1 < commandHistory.logCount ? commandHistory.logOffsets[index + 1]
+                                                                          : commandHistory.logLength) - 1;
+    }
+    *length = end - entry;
+
+    return entry;
+}
+
+/**
+ * Append a command to the log of this session.
+ *
+ * @param command The command
+ */
+void addToHistory(const char *command)
+{
+    size_t length = strlen(command);
+    if (commandHistory.logLength + length + 1 > commandHistory.logCapacity) {
+        commandHistory.logCapacity = commandHistory.logCapacity == 0 ? 4096 : commandHistory.logCapacity * 2;
+        while (commandHistory.logCapacity < commandHistory.logLength + length + 1) {
+            commandHistory.logCapacity *= 2;
+        }
+        commandHistory.log = realloc(commandHistory.log, commandHistory.logCapacity);
+        if (commandHistory.log == NULL) {
+            printf("Error: realloc failed in addToHistory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (commandHistory.logCount == commandHistory.logOffsetsCapacity) {
+        size_t capacity = commandHistory.logOffsetsCapacity;
+        commandHistory.logOffsetsCapacity = capacity == 0 ? 256 : capacity * 2;
+        commandHistory.logOffsets = realloc(commandHistory.logOffsets,
+                                            commandHistory.logOffsetsCapacity * sizeof(size_t));
+        commandHistory.logUsages = realloc(commandHistory.logUsages,
+                                           commandHistory.logOffsetsCapacity * sizeof(ResourceUsage));
+        if (commandHistory.logOffsets == NULL || commandHistory.logUsages == NULL) {
+            printf("Error: realloc failed in addToHistory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memset(&commandHistory.logUsages[commandHistory.logCount], 0, sizeof(ResourceUsage));
+    commandHistory.logUsages[commandHistory.logCount].wallSeconds = -1;
+    commandHistory.logOffsets[commandHistory.logCount++] = commandHistory.logLength;
+    memcpy(commandHistory.log + commandHistory.logLength, command, length);
+    commandHistory.log[commandHistory.logLength + length] = '\n';
+    commandHistory.logLength += length + 1;
+}
+
+/**
+ * Find the most recent command in the history starting with a prefix.
+ *
+ * @param prefix The prefix
+ * @return The number of the command, or 0 if there is none
+ */
+size_t findHistoryByPrefix(const char *prefix)
+{
+    size_t prefixLength = strlen(prefix);
+    for (size_t number = countHistory(); number > 0; --number) {
+        size_t length;
+        const char *entry = getHistoryEntry(number, &length);
+        if (length >= prefixLength && memcmp(entry, prefix, prefixLength) == 0) {
+            return number;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Print a command of the history after the prompt, add it to the history again and do it.
  *
- * @param history 10 most recent executed commands
- * @param commandCounter The current count of issued commands
- * @param historyIndex The current position in the history index
+ * @param number The number of the command
+ */
+void runHistoryEntry(size_t number)
+{
+    size_t length;
+    const char *entry = getHistoryEntry(number, &length);
+    char *command = strndup(entry, length);
+    if (command == NULL) {
+        printf("Error: strndup failed in runHistoryEntry\n");
+        exit(EXIT_FAILURE);
+    }
+
+    PROMPT();
+    printf("%s\n", command);
+    addToHistory(command);
+    doCommand(command);
+    free(command);
+}
+
+/**
+ * Print the 10 most recent commands to the console, the most recent first.
  */
-void printCommandHistory(char history[MAX_COMMANDS_IN_HISTORY][MAX_COMMAND_LENGTH], int commandCounter, int historyIndex)
+void printCommandHistory(void)
 {
-    if (strcmp(history[0], "") == 0) {
+    size_t count = countHistory();
+    if (count == 0) {
         printf("No commands in history.\n");
         return;
     }
 
-    int startIndex = (historyIndex - 1 + MAX_COMMANDS_IN_HISTORY) % MAX_COMMANDS_IN_HISTORY;
-    for (int i = 0, j = 0; i < MAX_COMMANDS_IN_HISTORY; i++, j++) {
-        if (strcmp("", history[i]) != 0) {
-            int index = (startIndex - i + MAX_COMMANDS_IN_HISTORY) % MAX_COMMANDS_IN_HISTORY;
-            printf("%d: %s\n", commandCounter - j, history[index]);
+    for (size_t number = count; number > 0 && count - number < MAX_COMMANDS_IN_HISTORY; --number) {
+        size_t length;
+        const char *entry = getHistoryEntry(number, &length);
+        printf("%zu: %.*s\n", number, (int) length, entry);
+    }
+}
+
+/**
+ * Print the 10 most recent commands of this session with the resource usage of their jobs, the most recent
+ * first, and the totals of every job the shell has run.
+ */
+void printCommandHistoryUsage(void)
+{
+    size_t count = countHistory();
+    printResourceUsage(stdout, NULL, "command");
+    for (size_t i = 0; i < commandHistory.logCount && i < MAX_COMMANDS_IN_HISTORY; ++i) {
+        ResourceUsage *usage = &commandHistory.logUsages[commandHistory.logCount - 1 - i];
+        size_t length;
+        const char *entry = getHistoryEntry(count - i, &length);
+        char name[64];
+        snprintf(name, sizeof(name), "%zu: %.*s", count - i, (int) (length < 48 ? length : 48), entry);
+        if (usage->wallSeconds < 0) {
+            printf("%9s %9s %9s %11s %13s  %s\n", "-", "-", "-", "-", "-", name);
+        } else {
+            printResourceUsage(stdout, usage, name);
+        }
+    }
+
+    char totalName[64];
+    snprintf(totalName, sizeof(totalName), "total of %ld jobs", finishedJobCount);
+    printResourceUsage(stdout, &commandTotals, totalName);
+}
+
+/**
+ * Print every command in the history containing a text, the oldest first.
+ *
+ * @param text The text
+ */
+void searchCommandHistory(const char *text)
+{
+    size_t textLength = strlen(text);
+    size_t count = countHistory();
+    bool found = false;
+    for (size_t number = 1; number <= count; ++number) {
+        size_t length;
+        const char *entry = getHistoryEntry(number, &length);
+        if (memmem(entry, length, text, textLength) != NULL) {
+            printf("%zu: %.*s\n", number, (int) length, entry);
+            found = true;
         }
     }
+    if (!found) {
+        printf("No such command in history.\n");
+    }
+}
+
+/**
+ * Append the commands of this session to the history file of an interactive shell. The log is written with
+ * one write to a file opened with O_APPEND, so shells exiting at the same time do not mix their lines
+ * without taking a lock.
+ */
+void saveHistory(void)
+{
+    if (!interactive || commandHistory.fileName == NULL || commandHistory.logLength == 0) {
+        return;
+    }
+
+    int fileDescriptor = open(commandHistory.fileName, O_WRONLY | O_CREAT | O_APPEND, 0600);
+    if (fileDescriptor < 0) {
+        perror(commandHistory.fileName);
+        return;
+    }
+    if (write(fileDescriptor, commandHistory.log, commandHistory.logLength) < 0) {
+        perror(commandHistory.fileName);
+    }
+    close(fileDescriptor);
 }
 
 /**
- * Do the issued command.
+ * Do the issued command. A command with the time prefix, or every command with -T, is timed.
  *
- * @param command The issued command
+ * @param command The issued command, which is split into its tokens
  */
-void doCommand(char command[MAX_COMMAND_LENGTH])
+void doCommand(char command[])
 {
+    bool timed = timeCommands;
+    if (strncmp("time ", command, 5) == 0) {
+        timed = true;
+        command += 5;
+    }
+
     char **parsedCommand = parseCommand(command);
-    executeCommandInChildProcess(parsedCommand);
-    freeCommand(parsedCommand);
+    if (parsedCommand == NULL) {
+        printf("Unterminated quote.\n");
+    } else if (parsedCommand[0] != NULL) {
+        executeCommandInChildProcess(parsedCommand, timed);
+    }
 }
 
 /**
- * Parse the issued command.
+ * Parse the issued command by splitting it into tokens in place. Quotes are removed and escaped characters
+ * moved into place as the tokens are written back over the command, which never gets ahead of the reading.
+ * Text in single quotes is taken as it is, and a backslash escapes any character outside quotes and a
+ * double quote or backslash inside double quotes. The unquoted operators |, <, >, >> and & are tokens of
+ * their own, also without spaces around them, and point to the shell operators.
  *
  * @param input The issued command
- * @return Parsed command
+ * @return Parsed command in the argument arena, or NULL if a quote is not terminated
  */
 char **parseCommand(char input[])
 {
-    char **parsedCommand;
-    char *pointerToEndOfToken;
-    char *tempToken = strdup(input);
+    size_t tokenCount = 0;
+    char *read = input;
+    char *write = input;
+    while (true) {
+        if (tokenCount + 3 > argumentArena.capacity) {
+            argumentArena.capacity = argumentArena.capacity == 0 ? 64 : argumentArena.capacity * 2;
+            argumentArena.arguments = realloc(argumentArena.arguments, argumentArena.capacity * sizeof(char *));
+            if (argumentArena.arguments == NULL) {
+                printf("Error: realloc failed in parseCommand\n");
+                exit(EXIT_FAILURE);
+            }
+        }
 
-    int tokenCount = 0;
-    char *tokens[MAX_COMMAND_LENGTH];
-    char *token = strtok_r(tempToken, " ", &pointerToEndOfToken);
-    while (token != NULL && tokenCount < MAX_COMMAND_LENGTH) {
-        tokens[tokenCount] = strdup(token);
-        tokenCount++;
-        token = strtok_r(NULL, " ", &pointerToEndOfToken);
+        while (*read == ' ' || *read == '\t') {
+            read++;
+        }
+        if (*read == '\0') {
+            break;
+        } else if (strchr("|<>&", *read) != NULL) {
+            read = readOperator(*read, read + 1, &argumentArena.arguments[tokenCount++]);
+            continue;
+        }
+
+        char *token = write;
+        char quote = '\0';
+        while (*read != '\0' && (quote != '\0' || strchr(" \t|<>&", *read) == NULL)) {
+            if (quote == '\0' && (*read == '\'' || *read == '"')) {
+                quote = *read++;
+            } else if (quote != '\0' && *read == quote) {
+                quote = '\0';
+                read++;
+            } else if (*read == '\\' && read[1] != '\0' && quote != '\''
+                       && (quote == '\0' || read[1] == '"' || read[1] == '\\')) {
+                read++;
+                *write++ = *read++;
+            } else {
+                *write++ = *read++;
+            }
+        }
+        if (quote != '\0') {
+            return NULL;
+        }
+
+        char separator = *read;
+        *write++ = '\0';
+        argumentArena.arguments[tokenCount++] = token;
+        if (write > read) {
+            if (separator == '\0') {
+                break;
+            }
+            read++;
+            if (separator != ' ' && separator != '\t') {
+                read = readOperator(separator, read, &argumentArena.arguments[tokenCount++]);
+            }
+        }
     }
-    free(tempToken);
+    argumentArena.arguments[tokenCount] = NULL;
 
-    parsedCommand = malloc(tokenCount * sizeof (char*) + sizeof(NULL));
-    if (parsedCommand == NULL) {
-        printf("Error: malloc failed in parseCommand\n");
-        exit(EXIT_FAILURE);
+    return argumentArena.arguments;
+}
+
+/**
+ * Read an operator of a command.
+ *
+ * @param first The first character of the operator
+ * @param rest The command after the first character
+ * @param token Pointer to the token of the operator
+ * @return The command after the operator
+ */
+char *readOperator(char first, char *rest, char **token)
+{
+    if (first == '>' && *rest == '>') {
+        *token = shellOperators[4];
+        return rest + 1;
     }
 
-    memcpy(parsedCommand, tokens, tokenCount * sizeof (char*) + sizeof(NULL));
-    parsedCommand[tokenCount] = NULL;
+    *token = shellOperators[strchr("|<>&", first) - "|<>&"];
+    return rest;
+}
+
+/**
+ * Checks if a token is an unquoted operator.
+ *
+ * @param token The token
+ * @param operator The operator
+ * @return The token is the operator
+ */
+bool isOperator(const char *token, const char *operator)
+{
+    for (size_t i = 0; i < sizeof(shellOperators) / sizeof(shellOperators[0]); ++i) {
+        if (token == shellOperators[i]) {
+            return strcmp(token, operator) == 0;
+        }
+    }
 
-    return parsedCommand;
+    return false;
 }
 
 /**
- * Execute the command in a child process.
+ * Execute the command in child processes, one for each command of its pipeline. The commands are wired
+ * together with pipes, and each child opens its own redirection files. The pipeline becomes a job in its
+ * own process group, which gets the terminal while the shell waits for it. A concurrent command waits for
+ * another one to finish first when the job limit is reached, and reads from /dev/null in a script.
  *
  * @param input The command to execute
+ * @param timed Print the resource usage of the job when it finishes
  * @return Status code
  */
-int executeCommandInChildProcess(char *command[])
+int executeCommandInChildProcess(char *command[], bool timed)
 {
-    pid_t pid;
     bool runConcurrently = false;
 
     int lastCommandArgumentIndex = 0;
     while (command[lastCommandArgumentIndex] != NULL) {
         lastCommandArgumentIndex++;
-    } if (strcmp(command[lastCommandArgumentIndex - 1], "&") == 0 ) {
+    } if (isOperator(command[lastCommandArgumentIndex - 1], "&")) {
         if (lastCommandArgumentIndex != 1) {
-            free(command[lastCommandArgumentIndex - 1]);
             command[lastCommandArgumentIndex - 1] = NULL;
             runConcurrently = true;
         }
     }
 
-    pid = fork();
-    if (pid < 0) {
-        fprintf(stderr, "Fork Failed");
+    Pipeline pipeline;
+    if (!parsePipeline(command, &pipeline)) {
+        printf("Invalid pipeline.\n");
         return 1;
-    } else if (pid == 0) { /* child process */
-        execvp(command[0], command);
-        exit(0);
-    } else { /* parent process */
+    }
+    char *commandText = joinCommand(command);
+
+    pid_t *pids = malloc(pipeline.stageCount * sizeof(pid_t));
+    if (pids == NULL) {
+        printf("Error: malloc failed in executeCommandInChildProcess\n");
+        exit(EXIT_FAILURE);
+    }
+    while (runConcurrently && jobLimit > 0 && countRunningJobs() >= jobLimit) {
+        sigsuspend(&unblockedSignalMask);
+    }
+
+    int status = 0;
+    int startedStages = 0;
+    pid_t processGroup = 0;
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    int inputDescriptor = STDIN_FILENO;
+    if (runConcurrently && !interactive && pipeline.stages[0].inputFile == NULL) {
+        inputDescriptor = open("/dev/null", O_RDONLY);
+    }
+    for (int i = 0; i < pipeline.stageCount; ++i) {
+        int stagePipe[2] = { -1, STDOUT_FILENO };
+        if (i < pipeline.stageCount - 1 && pipe(stagePipe) < 0) {
+            perror("pipe");
+            status = 1;
+            break;
+        }
+
+        pids[i] = startPipelineStage(&pipeline.stages[i], inputDescriptor, stagePipe[1], stagePipe[0],
+                                     processGroup);
+        if (inputDescriptor != STDIN_FILENO) {
+            close(inputDescriptor);
+        }
+        if (stagePipe[1] != STDOUT_FILENO) {
+            close(stagePipe[1]);
+        }
+        inputDescriptor = stagePipe[0];
+        if (pids[i] < 0) {
+            status = 1;
+            break;
+        }
+        if (startedStages++ == 0 && jobControl) {
+            processGroup = pids[0];
+            if (!runConcurrently) {
+                giveTerminalTo(processGroup);
+            }
+        }
+    }
+    if (inputDescriptor != STDIN_FILENO && inputDescriptor >= 0) {
+        close(inputDescriptor);
+    }
+
+    if (startedStages == 0) {
+        free(commandText);
+        free(pids);
+    } else {
+        Job *job = addJob(pids, startedStages, processGroup, commandText, !runConcurrently);
+        job->startTime = startTime;
+        job->timed = timed;
+        for (int i = 0; i < startedStages; ++i) {
+            job->processNames[i] = strdup(pipeline.stages[i].arguments[0]);
+        }
         if (!runConcurrently) {
-            wait(NULL);
+            int jobStatus = waitForForegroundJob(job);
+            status = status != 0 ? status : jobStatus;
+        } else if (interactive) {
+            printf("[%d] %d\n", job->number, pids[startedStages - 1]);
+        }
+    }
+    freePipeline(&pipeline);
+
+    return status;
+}
+
+/**
+ * Splits a parsed command into the commands of its pipeline and their redirections.
+ *
+ * @param command The parsed command
+ * @param pipeline The pipeline
+ * @return The pipeline is valid
+ */
+bool parsePipeline(char *command[], Pipeline *pipeline)
+{
+    int tokenCount = 0;
+    pipeline->stageCount = 1;
+    while (command[tokenCount] != NULL) {
+        if (isOperator(command[tokenCount], "|")) {
+            pipeline->stageCount++;
+        }
+        tokenCount++;
+    }
+
+    pipeline->stages = calloc(pipeline->stageCount, sizeof(PipelineStage));
+    char **arguments = malloc((tokenCount + pipeline->stageCount) * sizeof(char *));
+    if (pipeline->stages == NULL || arguments == NULL) {
+        printf("Error: malloc failed in parsePipeline\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bool valid = true;
+    int argumentCount = 0;
+    PipelineStage *stage = &pipeline->stages[0];
+    stage->arguments = arguments;
+    for (int i = 0; i < tokenCount && valid; ++i) {
+        char *token = command[i];
+        if (isOperator(token, "|")) {
+            arguments[argumentCount++] = NULL;
+            stage++;
+            stage->arguments = &arguments[argumentCount];
+        } else if (isOperator(token, "<") || isOperator(token, ">") || isOperator(token, ">>")) {
+            char *filename = command[++i];
+            valid = filename != NULL;
+            if (token[0] == '<') {
+                valid = valid && stage == &pipeline->stages[0];
+                stage->inputFile = filename;
+            } else {
+                valid = valid && stage == &pipeline->stages[pipeline->stageCount - 1];
+                stage->outputFile = filename;
+                stage->appendOutput = token[1] == '>';
+            }
+        } else {
+            arguments[argumentCount++] = token;
         }
+    }
+    arguments[argumentCount] = NULL;
 
-        return 0;
+    for (int i = 0; i < pipeline->stageCount && valid; ++i) {
+        valid = pipeline->stages[i].arguments[0] != NULL;
+    }
+    if (!valid) {
+        freePipeline(pipeline);
     }
+
+    return valid;
+}
+
+/**
+ * Deallocate memory for a pipeline. The tokens belong to the parsed command.
+ *
+ * @param pipeline The pipeline
+ */
+void freePipeline(Pipeline *pipeline)
+{
+    free(pipeline->stages[0].arguments);
+    free(pipeline->stages);
 }
 
 /**
- * Deallocate memory for an executed command.
+ * Start a command of a pipeline in a child process, without waiting for it. Commands are spawned with
+ * posix_spawnp, which does not copy the page tables of the shell. Only cat done by the shell needs the
+ * shell in the child and is forked, as is every command with -F. A command with redirections that could
+ * not be spawned is forked as well, so the child reports which file failed. The command is started from
+ * the path remembered for it, which is looked up again if the command is no longer there. The child gets
+ * the signal mask and the stop signals and SIGPIPE the shell had before it took control of them.
  *
- * @param executedCommand The executed command
+ * @param stage The command
+ * @param inputDescriptor Where the command reads from
+ * @param outputDescriptor Where the command writes to
+ * @param unusedDescriptor The read end of the pipe to the next command, or -1
+ * @param processGroup The process group of the job with job control, or 0 for a new group led by the child
+ * @return The pid of the child process, or -1 if the fork failed
  */
-void freeCommand(char **executedCommand) {
-    int i = 0;
-    while (executedCommand[i] != NULL) {
-        free(executedCommand[i]);
-        i++;
+pid_t startPipelineStage(PipelineStage *stage, int inputDescriptor, int outputDescriptor, int unusedDescriptor,
+                         pid_t processGroup)
+{
+    pid_t pid;
+
+    fflush(stdout);
+    bool catByShell = isPlainCat(stage->arguments);
+    char *commandPath = catByShell ? NULL : findCommand(stage->arguments[0]);
+    if (!alwaysFork && !catByShell) {
+        int error = spawnPipelineStage(stage, commandPath, inputDescriptor, outputDescriptor, unusedDescriptor,
+                                       processGroup, &pid);
+        if (error == ENOENT && commandPath != NULL) {
+            forgetCommand(stage->arguments[0]);
+            commandPath = findCommand(stage->arguments[0]);
+            error = spawnPipelineStage(stage, commandPath, inputDescriptor, outputDescriptor, unusedDescriptor,
+                                       processGroup, &pid);
+        }
+        if (error == 0) {
+            return pid;
+        } else if (stage->inputFile == NULL && stage->outputFile == NULL) {
+            fprintf(stderr, "%s: %s\n", stage->arguments[0], strerror(error));
+            return -1;
+        }
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Fork Failed");
+        return -1;
+    } else if (pid == 0) { /* child process */
+        if (jobControl) {
+            setpgid(0, processGroup);
+        }
+        signal(SIGTSTP, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL);
+        signal(SIGTTOU, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+        sigprocmask(SIG_SETMASK, &unblockedSignalMask, NULL);
+        if (unusedDescriptor >= 0) {
+            close(unusedDescriptor);
+        }
+        if (inputDescriptor != STDIN_FILENO) {
+            dup2(inputDescriptor, STDIN_FILENO);
+            close(inputDescriptor);
+        }
+        if (outputDescriptor != STDOUT_FILENO) {
+            dup2(outputDescriptor, STDOUT_FILENO);
+            close(outputDescriptor);
+        }
+        redirectStage(stage);
+
+        if (catByShell) {
+            _exit(catFiles(stage->arguments + 1));
+        }
+        if (commandPath != NULL) {
+            execv(commandPath, stage->arguments);
+        }
+        execvp(stage->arguments[0], stage->arguments);
+        exit(0);
+    } else { /* parent process */
+        if (jobControl) {
+            setpgid(pid, processGroup == 0 ? pid : processGroup);
+        }
+        return pid;
     }
-    free(executedCommand);
 }
 
 /**
- * Increments the current position in the history index.
+ * Spawn a command of a pipeline with posix_spawn, or posix_spawnp when it has no remembered path. The pipe
+ * ends are moved into place and the redirection files opened by file actions in the child, and the process
+ * group, signal mask and signals the shell ignores are set by the spawn attributes.
  *
- * @param historyIndex The history index
- * @param commandCounter The current count of issued commands
+ * @param stage The command
+ * @param commandPath The path of the command, or NULL
+ * @param inputDescriptor Where the command reads from
+ * @param outputDescriptor Where the command writes to
+ * @param unusedDescriptor The read end of the pipe to the next command, or -1
+ * @param processGroup The process group of the job with job control, or 0 for a new group led by the child
+ * @param pid Pointer to the pid of the child process
+ * @return 0, or the error number if the command could not be spawned
  */
-void incrementIndex(int *historyIndex, int *commandCounter)
+int spawnPipelineStage(PipelineStage *stage, char *commandPath, int inputDescriptor, int outputDescriptor,
+                       int unusedDescriptor, pid_t processGroup, pid_t *pid)
 {
-    *commandCounter = *commandCounter + 1;
-    *historyIndex = *commandCounter % MAX_COMMANDS_IN_HISTORY;
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (unusedDescriptor >= 0) {
+        posix_spawn_file_actions_addclose(&actions, unusedDescriptor);
+    }
+    if (inputDescriptor != STDIN_FILENO) {
+        posix_spawn_file_actions_adddup2(&actions, inputDescriptor, STDIN_FILENO);
+        posix_spawn_file_actions_addclose(&actions, inputDescriptor);
+    }
+    if (outputDescriptor != STDOUT_FILENO) {
+        posix_spawn_file_actions_adddup2(&actions, outputDescriptor, STDOUT_FILENO);
+        posix_spawn_file_actions_addclose(&actions, outputDescriptor);
+    }
+    if (stage->inputFile != NULL) {
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, stage->inputFile, O_RDONLY, 0);
+    }
+    if (stage->outputFile != NULL) {
+        int openFlags = O_WRONLY | O_CREAT | (stage->appendOutput ? O_APPEND : O_TRUNC);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, stage->outputFile, openFlags, 0666);
+    }
+
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGTSTP);
+    sigaddset(&defaultSignals, SIGTTIN);
+    sigaddset(&defaultSignals, SIGTTOU);
+    sigaddset(&defaultSignals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    posix_spawnattr_setsigmask(&attributes, &unblockedSignalMask);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    if (jobControl) {
+        posix_spawnattr_setpgroup(&attributes, processGroup);
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    posix_spawnattr_setflags(&attributes, flags);
+
+    extern char **environ;
+    int error;
+    if (commandPath != NULL) {
+        error = posix_spawn(pid, commandPath, &actions, &attributes, stage->arguments, environ);
+    } else {
+        error = posix_spawnp(pid, stage->arguments[0], &actions, &attributes, stage->arguments, environ);
+    }
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+
+    return error;
+}
+
+/**
+ * Opens the redirection files of a command once and puts them in place of its input and output. Exits
+ * the child process if a file can not be opened.
+ *
+ * @param stage The command
+ */
+void redirectStage(PipelineStage *stage)
+{
+    if (stage->inputFile != NULL) {
+        int fileDescriptor = open(stage->inputFile, O_RDONLY);
+        if (fileDescriptor < 0) {
+            perror(stage->inputFile);
+            _exit(1);
+        }
+        dup2(fileDescriptor, STDIN_FILENO);
+        close(fileDescriptor);
+    }
+    if (stage->outputFile != NULL) {
+        int flags = O_WRONLY | O_CREAT | (stage->appendOutput ? O_APPEND : O_TRUNC);
+        int fileDescriptor = open(stage->outputFile, flags, 0666);
+        if (fileDescriptor < 0) {
+            perror(stage->outputFile);
+            _exit(1);
+        }
+        dup2(fileDescriptor, STDOUT_FILENO);
+        close(fileDescriptor);
+    }
+}
+
+/**
+ * Checks if a command is cat without options, which the shell can do itself.
+ *
+ * @param arguments The command and its arguments
+ * @return The command is cat with only file arguments
+ */
+bool isPlainCat(char **arguments)
+{
+    if (strcmp(arguments[0], "cat") != 0) {
+        return false;
+    }
+    for (int i = 1; arguments[i] != NULL; ++i) {
+        if (arguments[i][0] == '-') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Copies files, or the input when there are none, to the output.
+ *
+ * @param filenames The files
+ * @return Status code
+ */
+int catFiles(char **filenames)
+{
+    if (filenames[0] == NULL) {
+        return copyFileDescriptor(STDIN_FILENO, STDOUT_FILENO) ? 0 : 1;
+    }
+
+    int status = 0;
+    for (int i = 0; filenames[i] != NULL; ++i) {
+        int fileDescriptor = open(filenames[i], O_RDONLY);
+        if (fileDescriptor < 0) {
+            perror(filenames[i]);
+            status = 1;
+            continue;
+        }
+        if (!copyFileDescriptor(fileDescriptor, STDOUT_FILENO)) {
+            status = 1;
+        }
+        close(fileDescriptor);
+    }
+
+    return status;
+}
+
+/**
+ * Copies everything from one file descriptor to another without going through user space when possible.
+ * splice is used when either end is a pipe and sendfile from a regular file, otherwise the data is read
+ * and written through a buffer.
+ *
+ * @param from The descriptor to copy from
+ * @param to The descriptor to copy to
+ * @return The copy succeeded
+ */
+bool copyFileDescriptor(int from, int to)
+{
+    struct stat fromStatus;
+    struct stat toStatus;
+    if (fstat(from, &fromStatus) < 0 || fstat(to, &toStatus) < 0) {
+        perror("fstat");
+        return false;
+    }
+
+    bool throughKernel = true;
+    bool anyPipe = S_ISFIFO(fromStatus.st_mode) || S_ISFIFO(toStatus.st_mode);
+    bool moved = false;
+    while (throughKernel) {
+        ssize_t bytesMoved;
+        if (anyPipe) {
+            bytesMoved = splice(from, NULL, to, NULL, COPY_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE);
+        } else if (S_ISREG(fromStatus.st_mode)) {
+            bytesMoved = sendfile(to, from, NULL, COPY_CHUNK_SIZE);
+        } else {
+            break;
+        }
+
+        if (bytesMoved == 0) {
+            return true;
+        } else if (bytesMoved < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (!moved && (errno == EINVAL || errno == ENOSYS)) {
+                throughKernel = false;
+            } else {
+                perror("copy");
+                return false;
+            }
+        }
+        moved = true;
+    }
+
+    char *buffer = malloc(COPY_CHUNK_SIZE);
+    if (buffer == NULL) {
+        printf("Error: malloc failed in copyFileDescriptor\n");
+        exit(EXIT_FAILURE);
+    }
+    bool copied = true;
+    ssize_t bytesRead;
+    while (copied && (bytesRead = read(from, buffer, COPY_CHUNK_SIZE)) != 0) {
+        if (bytesRead < 0) {
+            copied = errno == EINTR;
+            continue;
+        }
+        for (ssize_t written = 0; copied && written < bytesRead;) {
+            ssize_t bytesWritten = write(to, buffer + written, bytesRead - written);
+            if (bytesWritten < 0) {
+                copied = errno == EINTR;
+            } else {
+                written += bytesWritten;
+            }
+        }
+    }
+    free(buffer);
+    if (!copied) {
+        perror("copy");
+    }
+
+    return copied;
+}
+
+/**
+ * Find the path of a command in the hash table, or search PATH for it and remember it. The table is
+ * cleared when PATH has changed since it was filled.
+ *
+ * @param name The command name
+ * @return The path of the command, or NULL if the name has a slash or the command was not found
+ */
+char *findCommand(char *name)
+{
+    if (strchr(name, '/') != NULL) {
+        return NULL;
+    }
+
+    const char *searchPath = getenv("PATH");
+    if (searchPath == NULL) {
+        searchPath = "/bin:/usr/bin";
+    }
+    if (commandHashTable.searchPath == NULL || strcmp(commandHashTable.searchPath, searchPath) != 0) {
+        clearCommandHashTable();
+        free(commandHashTable.searchPath);
+        commandHashTable.searchPath = strdup(searchPath);
+    }
+
+    CommandHashEntry *entry = findCommandEntry(name);
+    if (entry->path != NULL) {
+        commandHashTable.hits++;
+        entry->hits++;
+        return entry->path;
+    }
+
+    commandHashTable.misses++;
+    entry->path = searchCommandPath(searchPath, name);
+    entry->hits = entry->path != NULL ? 1 : 0;
+
+    return entry->path;
+}
+
+/**
+ * Find the entry of a command name, adding an entry without a path if there is none.
+ *
+ * @param name The command name
+ * @return The entry
+ */
+CommandHashEntry *findCommandEntry(char *name)
+{
+    if ((commandHashTable.count + 1) * 2 > commandHashTable.capacity) {
+        growCommandHashTable();
+    }
+
+    size_t mask = commandHashTable.capacity - 1;
+    size_t index = hashCommandName(name) & mask;
+    while (commandHashTable.entries[index].name != NULL) {
+        if (strcmp(commandHashTable.entries[index].name, name) == 0) {
+            return &commandHashTable.entries[index];
+        }
+        index = (index + 1) & mask;
+    }
+
+    CommandHashEntry *entry = &commandHashTable.entries[index];
+    entry->name = strdup(name);
+    if (entry->name == NULL) {
+        printf("Error: strdup failed in findCommandEntry\n");
+        exit(EXIT_FAILURE);
+    }
+    commandHashTable.count++;
+
+    return entry;
+}
+
+/**
+ * Double the capacity of the hash table and move the entries to their new places.
+ */
+void growCommandHashTable(void)
+{
+    size_t oldCapacity = commandHashTable.capacity;
+    CommandHashEntry *oldEntries = commandHashTable.entries;
+    commandHashTable.capacity = oldCapacity == 0 ? INITIAL_HASH_CAPACITY : oldCapacity * 2;
+    commandHashTable.entries = calloc(commandHashTable.capacity, sizeof(CommandHashEntry));
+    if (commandHashTable.entries == NULL) {
+        printf("Error: calloc failed in growCommandHashTable\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t mask = commandHashTable.capacity - 1;
+    for (size_t i = 0; i < oldCapacity; ++i) {
+        if (oldEntries[i].name != NULL) {
+            size_t index = hashCommandName(oldEntries[i].name) & mask;
+            while (commandHashTable.entries[index].name != NULL) {
+                index = (index + 1) & mask;
+            }
+            commandHashTable.entries[index] = oldEntries[i];
+        }
+    }
+    free(oldEntries);
+}
+
+/**
+ * Search the directories of PATH for an executable file with the command name. An empty directory is the
+ * current directory.
+ *
+ * @param searchPath The value of PATH
+ * @param name The command name
+ * @return The allocated path of the command, or NULL if it was not found
+ */
+char *searchCommandPath(const char *searchPath, const char *name)
+{
+    size_t nameLength = strlen(name);
+    const char *directory = searchPath;
+    while (true) {
+        const char *directoryEnd = strchr(directory, ':');
+        size_t directoryLength = directoryEnd != NULL ? (size_t) (directoryEnd - directory) : strlen(directory);
+
+        char *candidate = malloc(directoryLength + nameLength + 3);
+        if (candidate == NULL) {
+            printf("Error: malloc failed in searchCommandPath\n");
+            exit(EXIT_FAILURE);
+        }
+        if (directoryLength == 0) {
+            sprintf(candidate, "./%s", name);
+        } else {
+            sprintf(candidate, "%.*s/%s", (int) directoryLength, directory, name);
+        }
+
+        struct stat status;
+        if (stat(candidate, &status) == 0 && S_ISREG(status.st_mode) && access(candidate, X_OK) == 0) {
+            return candidate;
+        }
+        free(candidate);
+
+        if (directoryEnd == NULL) {
+            return NULL;
+        }
+        directory = directoryEnd + 1;
+    }
+}
+
+/**
+ * Forget the path of a command, so it is looked up again next time.
+ *
+ * @param name The command name
+ */
+void forgetCommand(char *name)
+{
+    CommandHashEntry *entry = findCommandEntry(name);
+    free(entry->path);
+    entry->path = NULL;
+}
+
+/**
+ * Forget the paths of all commands. The hits and misses are kept.
+ */
+void clearCommandHashTable(void)
+{
+    for (size_t i = 0; i < commandHashTable.capacity; ++i) {
+        free(commandHashTable.entries[i].name);
+        free(commandHashTable.entries[i].path);
+    }
+    free(commandHashTable.entries);
+    commandHashTable.entries = NULL;
+    commandHashTable.capacity = 0;
+    commandHashTable.count = 0;
+}
+
+/**
+ * Print the remembered paths of commands with how often each was used, and the hits and misses of the
+ * lookups.
+ */
+void printCommandHashTable(void)
+{
+    bool empty = true;
+    for (size_t i = 0; i < commandHashTable.capacity; ++i) {
+        CommandHashEntry *entry = &commandHashTable.entries[i];
+        if (entry->path != NULL) {
+            if (empty) {
+                printf("hits\tcommand\n");
+                empty = false;
+            }
+            printf("%4ld\t%s\n", entry->hits, entry->path);
+        }
+    }
+    if (empty) {
+        printf("No commands in hash table.\n");
+    }
+    printf("Lookups: %ld hits, %ld misses\n", commandHashTable.hits, commandHashTable.misses);
+}
+
+/**
+ * Hash a command name with 64-bit FNV-1a.
+ *
+ * @param name The command name
+ * @return The hash
+ */
+uint64_t hashCommandName(const char *name)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *byte = (const unsigned char *) name; *byte != '\0'; ++byte) {
+        hash = (hash ^ *byte) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/**
+ * Install the SIGCHLD handler that reaps the processes of jobs. SIGCHLD is blocked except while the shell
+ * reads a command or waits for a job, so the handler never sees the job table while it is being changed.
+ * SIGPIPE is ignored, so writing to a coprocess that has finished is an error instead of the end of the
+ * shell. An interactive shell on a terminal also takes job control: it ignores the stop signals and gives the
+ * terminal to the job it waits for.
+ */
+void installJobControl(void)
+{
+    sigemptyset(&childSignalMask);
+    sigaddset(&childSignalMask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childSignalMask, &unblockedSignalMask);
+    sigdelset(&unblockedSignalMask, SIGCHLD);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = reapJobProcesses;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    jobControl = interactive && isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp();
+    if (jobControl) {
+        signal(SIGTSTP, SIG_IGN);
+        signal(SIGTTIN, SIG_IGN);
+        signal(SIGTTOU, SIG_IGN);
+    }
+}
+
+/**
+ * SIGCHLD handler. Collect every state change of the processes of the jobs with wait4 on their pids, so
+ * no other child of the shell is reaped by mistake and no finished process is left as a zombie. The exit
+ * status of the last process of a job is its exit status. The resource usage of each process is added to
+ * the job, and to the totals of all commands once the whole job has finished.
+ *
+ * @param signalNumber The signal
+ */
+void reapJobProcesses(int signalNumber)
+{
+    (void) signalNumber;
+    int savedErrno = errno;
+
+    for (int i = 0; i < jobTable.count; ++i) {
+        Job *job = &jobTable.jobs[i];
+        for (int j = 0; j < job->processCount; ++j) {
+            int status;
+            struct rusage usage;
+            while (job->processStates[j] != PROCESS_DONE
+                   && wait4(job->pids[j], &status, WNOHANG | WUNTRACED | WCONTINUED, &usage) > 0) {
+                if (WIFSTOPPED(status)) {
+                    if (job->processStates[j] == PROCESS_RUNNING) {
+                        job->processStates[j] = PROCESS_STOPPED;
+                        job->stoppedCount++;
+                    }
+                    job->stopSignal = WSTOPSIG(status);
+                } else if (WIFCONTINUED(status)) {
+                    if (job->processStates[j] == PROCESS_STOPPED) {
+                        job->processStates[j] = PROCESS_RUNNING;
+                        job->stoppedCount--;
+                    }
+                } else {
+                    if (job->processStates[j] == PROCESS_STOPPED) {
+                        job->stoppedCount--;
+                    }
+                    job->processStates[j] = PROCESS_DONE;
+                    job->runningCount--;
+                    if (j == job->processCount - 1) {
+                        job->exitStatus = status;
+                    }
+                    struct timespec now;
+                    clock_gettime(CLOCK_MONOTONIC, &now);
+                    ResourceUsage *processUsage = &job->processUsages[j];
+                    processUsage->wallSeconds = (now.tv_sec - job->startTime.tv_sec)
+                                                + (now.tv_nsec - job->startTime.tv_nsec) / 1e9;
+                    processUsage->userTime = usage.ru_utime;
+                    processUsage->systemTime = usage.ru_stime;
+                    processUsage->maxResidentKilobytes = usage.ru_maxrss;
+                    processUsage->voluntarySwitches = usage.ru_nvcsw;
+                    processUsage->involuntarySwitches = usage.ru_nivcsw;
+
+                    double jobWallSeconds = job->usage.wallSeconds;
+                    addResourceUsage(&job->usage, processUsage);
+                    job->usage.wallSeconds = processUsage->wallSeconds > jobWallSeconds ? processUsage->wallSeconds
+                                                                                        : jobWallSeconds;
+                    if (job->runningCount == 0) {
+                        addResourceUsage(&commandTotals, &job->usage);
+                        finishedJobCount++;
+                    }
+                }
+            }
+        }
+    }
+
+    errno = savedErrno;
+}
+
+/**
+ * Add the processes of a pipeline to the job table. A job is numbered one higher than the most recent job.
+ *
+ * @param pids The allocated pids of the processes, owned by the job table afterwards
+ * @param processCount The amount of processes
+ * @param processGroup The process group of the processes, or 0 without job control
+ * @param command The allocated command of the job, owned by the job table afterwards
+ * @param foreground The shell waits for the job
+ * @return The job, valid until a job is added or removed
+ */
+Job *addJob(pid_t *pids, int processCount, pid_t processGroup, char *command, bool foreground)
+{
+    if (jobTable.count == jobTable.capacity) {
+        jobTable.capacity = jobTable.capacity == 0 ? 16 : jobTable.capacity * 2;
+        jobTable.jobs = realloc(jobTable.jobs, jobTable.capacity * sizeof(Job));
+        if (jobTable.jobs == NULL) {
+            printf("Error: realloc failed in addJob\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    Job *job = &jobTable.jobs[jobTable.count];
+    memset(job, 0, sizeof(Job));
+    job->number = jobTable.count > 0 ? jobTable.jobs[jobTable.count - 1].number + 1 : 1;
+    job->processStates = calloc(processCount, sizeof(int));
+    job->processNames = calloc(processCount, sizeof(char *));
+    job->processUsages = calloc(processCount, sizeof(ResourceUsage));
+    if (job->processStates == NULL || job->processNames == NULL || job->processUsages == NULL) {
+        printf("Error: calloc failed in addJob\n");
+        exit(EXIT_FAILURE);
+    }
+    job->command = command;
+    job->processGroup = processGroup;
+    job->pids = pids;
+    job->processCount = processCount;
+    job->runningCount = processCount;
+    job->historyIndex = commandHistory.logCount - 1;
+    job->foreground = foreground;
+    jobTable.count++;
+
+    return job;
+}
+
+/**
+ * Join the tokens of a command with spaces.
+ *
+ * @param command The parsed command
+ * @return The allocated command
+ */
+char *joinCommand(char **command)
+{
+    size_t length = 1;
+    for (int i = 0; command[i] != NULL; ++i) {
+        length += strlen(command[i]) + 1;
+    }
+
+    char *joined = malloc(length);
+    if (joined == NULL) {
+        printf("Error: malloc failed in joinCommand\n");
+        exit(EXIT_FAILURE);
+    }
+    char *end = joined;
+    for (int i = 0; command[i] != NULL; ++i) {
+        end += sprintf(end, i == 0 ? "%s" : " %s", command[i]);
+    }
+    *end = '\0';
+
+    return joined;
+}
+
+/**
+ * Find a job by a job specification like %2 or 2, or the most recent job when the specification is empty.
+ *
+ * @param specification The job specification, which may start with spaces
+ * @return The job, or NULL if there is no such job
+ */
+Job *findJob(char *specification)
+{
+    while (*specification == ' ') {
+        specification++;
+    }
+    if (*specification == '\0') {
+        return jobTable.count > 0 ? &jobTable.jobs[jobTable.count - 1] : NULL;
+    }
+    if (*specification == '%') {
+        specification++;
+    }
+
+    int number = atoi(specification);
+    for (int i = 0; i < jobTable.count; ++i) {
+        if (jobTable.jobs[i].number == number) {
+            return &jobTable.jobs[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Continue a job, either in the foreground where the shell gives it the terminal and waits for it, or
+ * concurrently with the shell.
+ *
+ * @param specification The job specification
+ * @param foreground The job is continued in the foreground
+ */
+void resumeJob(char *specification, bool foreground)
+{
+    Job *job = findJob(specification);
+    if (job == NULL) {
+        printf("No such job.\n");
+        return;
+    }
+
+    if (foreground) {
+        printf("%s\n", job->command);
+        job->foreground = true;
+        giveTerminalTo(job->processGroup);
+        continueJob(job);
+        waitForForegroundJob(job);
+    } else if (job->stoppedCount == 0) {
+        printf("Job %d is already running.\n", job->number);
+    } else {
+        continueJob(job);
+        printf("[%d] %s &\n", job->number, job->command);
+    }
+}
+
+/**
+ * Send SIGCONT to the processes of a job, to its process group with job control, and count its stopped
+ * processes as running again.
+ *
+ * @param job The job
+ */
+void continueJob(Job *job)
+{
+    if (job->processGroup > 0) {
+        kill(-job->processGroup, SIGCONT);
+    }
+    for (int i = 0; i < job->processCount; ++i) {
+        if (job->processStates[i] != PROCESS_DONE) {
+            if (job->processGroup == 0) {
+                kill(job->pids[i], SIGCONT);
+            }
+            job->processStates[i] = PROCESS_RUNNING;
+        }
+    }
+    job->stoppedCount = 0;
+}
+
+/**
+ * Make a process group the foreground process group of the terminal, when the shell has job control.
+ *
+ * @param processGroup The process group
+ */
+void giveTerminalTo(pid_t processGroup)
+{
+    if (jobControl && processGroup > 0) {
+        tcsetpgrp(STDIN_FILENO, processGroup);
+    }
+}
+
+/**
+ * Wait for a foreground job to finish or stop, then take the terminal back. A finished job is removed from
+ * the job table, and a stopped job stays in it as a concurrent job. A process that read from the terminal
+ * before the job got it was stopped by SIGTTIN or SIGTTOU, and is continued.
+ *
+ * @param job The job
+ * @return The exit status of the job, or 128 plus the signal that ended it
+ */
+int waitForForegroundJob(Job *job)
+{
+    while (job->runningCount > 0) {
+        if (job->stoppedCount > 0) {
+            if (!jobControl || (job->stopSignal != SIGTTIN && job->stopSignal != SIGTTOU)) {
+                break;
+            }
+            continueJob(job);
+        }
+        sigsuspend(&unblockedSignalMask);
+    }
+    giveTerminalTo(getpgrp());
+
+    if (job->runningCount > 0) {
+        job->foreground = false;
+        printf("\n");
+        printJob(job);
+        return 128 + job->stopSignal;
+    }
+
+    int status = job->exitStatus;
+    removeJob(job - jobTable.jobs);
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/**
+ * Wait for a job to finish or stop, or for every job running concurrently when there is no job
+ * specification.
+ *
+ * @param specification The job specification
+ */
+void waitForJobs(char *specification)
+{
+    while (*specification == ' ') {
+        specification++;
+    }
+    if (*specification == '\0') {
+        waitForAllJobs();
+        return;
+    }
+
+    Job *job = findJob(specification);
+    if (job == NULL) {
+        printf("No such job.\n");
+        return;
+    }
+    while (job->runningCount > 0 && job->stoppedCount == 0) {
+        sigsuspend(&unblockedSignalMask);
+    }
+}
+
+/**
+ * Wait until no job is running. Stopped jobs are not waited for.
+ */
+void waitForAllJobs(void)
+{
+    bool waiting = true;
+    while (waiting) {
+        waiting = false;
+        for (int i = 0; i < jobTable.count; ++i) {
+            waiting = waiting || (jobTable.jobs[i].runningCount > 0 && jobTable.jobs[i].stoppedCount == 0);
+        }
+        if (waiting) {
+            sigsuspend(&unblockedSignalMask);
+        }
+    }
+}
+
+/**
+ * Count the jobs running concurrently with the shell. A stopped job counts as running.
+ *
+ * @return The amount of running jobs
+ */
+int countRunningJobs(void)
+{
+    int count = 0;
+    for (int i = 0; i < jobTable.count; ++i) {
+        if (jobTable.jobs[i].runningCount > 0 && !jobTable.jobs[i].foreground) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Print every job, then remove the finished ones.
+ */
+void printJobs(void)
+{
+    if (jobTable.count == 0) {
+        printf("No jobs.\n");
+        return;
+    }
+
+    for (int i = 0; i < jobTable.count; ++i) {
+        printJob(&jobTable.jobs[i]);
+    }
+    removeFinishedJobs(false);
+}
+
+/**
+ * Print the number, state and command of a job, and the exit status and resource usage of a finished job.
+ * The most recent job is marked with a +.
+ *
+ * @param job The job
+ */
+void printJob(Job *job)
+{
+    char state[32];
+    if (job->runningCount > 0) {
+        strcpy(state, job->stoppedCount > 0 ? "Stopped" : "Running");
+    } else if (WIFSIGNALED(job->exitStatus)) {
+        snprintf(state, sizeof(state), "%s", strsignal(WTERMSIG(job->exitStatus)));
+    } else if (WEXITSTATUS(job->exitStatus) != 0) {
+        snprintf(state, sizeof(state), "Exit %d", WEXITSTATUS(job->exitStatus));
+    } else {
+        strcpy(state, "Done");
+    }
+
+    char marker = job == &jobTable.jobs[jobTable.count - 1] ? '+' : ' ';
+    printf("[%d]%c  %-12s%s", job->number, marker, state, job->command);
+    if (job->runningCount == 0) {
+        printf("  (%.3f s user, %.3f s sys, %ld KB max RSS)",
+               job->usage.userTime.tv_sec + job->usage.userTime.tv_usec / 1e6,
+               job->usage.systemTime.tv_sec + job->usage.systemTime.tv_usec / 1e6,
+               job->usage.maxResidentKilobytes);
+    } else if (job->stoppedCount == 0) {
+        printf(" &");
+    }
+    printf("\n");
+}
+
+/**
+ * Remove the finished concurrent jobs from the job table.
+ *
+ * @param report Print each finished job before it is removed
+ */
+void removeFinishedJobs(bool report)
+{
+    for (int i = 0; i < jobTable.count;) {
+        Job *job = &jobTable.jobs[i];
+        if (job->runningCount == 0 && !job->foreground) {
+            if (report) {
+                printJob(job);
+            }
+            removeJob(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+/**
+ * Remove a job from the job table and deallocate its memory. The resource usage of a finished job is kept
+ * with its command in the history, and printed if the job is timed.
+ *
+ * @param index The index of the job in the job table
+ */
+void removeJob(int index)
+{
+    Job *job = &jobTable.jobs[index];
+    if (job->runningCount == 0 && job->historyIndex < commandHistory.logCount) {
+        commandHistory.logUsages[job->historyIndex] = job->usage;
+        if (job->timed) {
+            printJobUsage(job);
+        }
+    }
+
+    for (int i = 0; i < job->processCount; ++i) {
+        free(job->processNames[i]);
+    }
+    free(job->processNames);
+    free(job->processUsages);
+    free(job->command);
+    free(job->pids);
+    free(job->processStates);
+    jobTable.count--;
+    memmove(job, job + 1, (jobTable.count - index) * sizeof(Job));
+}
+
+/**
+ * Add resource usage to a total.
+ *
+ * @param total The total
+ * @param usage The resource usage
+ */
+void addResourceUsage(ResourceUsage *total, const ResourceUsage *usage)
+{
+    total->wallSeconds += usage->wallSeconds;
+    timeradd(&total->userTime, &usage->userTime, &total->userTime);
+    timeradd(&total->systemTime, &usage->systemTime, &total->systemTime);
+    if (usage->maxResidentKilobytes > total->maxResidentKilobytes) {
+        total->maxResidentKilobytes = usage->maxResidentKilobytes;
+    }
+    total->voluntarySwitches += usage->voluntarySwitches;
+    total->involuntarySwitches += usage->involuntarySwitches;
+}
+
+/**
+ * Print a line of resource usage in seconds, kilobytes and voluntary/involuntary context switches, or the
+ * header of the columns when there is no resource usage.
+ *
+ * @param stream Where to print
+ * @param usage The resource usage, or NULL
+ * @param name What used the resources
+ */
+void printResourceUsage(FILE *stream, const ResourceUsage *usage, const char *name)
+{
+    if (usage == NULL) {
+        fprintf(stream, "%9s %9s %9s %11s %13s  %s\n", "real", "user", "sys", "max RSS", "switches", name);
+        return;
+    }
+
+    char switches[32];
+    snprintf(switches, sizeof(switches), "%ld/%ld", usage->voluntarySwitches, usage->involuntarySwitches);
+    fprintf(stream, "%9.3f %9.3f %9.3f %8ld KB %13s  %s\n", usage->wallSeconds,
+           usage->userTime.tv_sec + usage->userTime.tv_usec / 1e6,
+           usage->systemTime.tv_sec + usage->systemTime.tv_usec / 1e6, usage->maxResidentKilobytes, switches,
+           name);
+}
+
+/**
+ * Print the resource usage of each command of a finished job, and of the whole pipeline when it has more
+ * than one command, to stderr.
+ *
+ * @param job The job
+ */
+void printJobUsage(Job *job)
+{
+    fflush(stdout);
+    printResourceUsage(stderr, NULL, "command");
+    for (int i = 0; i < job->processCount; ++i) {
+        printResourceUsage(stderr, &job->processUsages[i], job->processNames[i] != NULL ? job->processNames[i] : "?");
+    }
+    if (job->processCount > 1) {
+        printResourceUsage(stderr, &job->usage, job->command);
+    }
+}
+
+/**
+ * Do a coproc builtin: start a coprocess, send it lines, close it, or print what it is.
+ *
+ * @param arguments The arguments of the builtin, which may start with spaces
+ */
+void doCoprocessCommand(char *arguments)
+{
+    while (*arguments == ' ') {
+        arguments++;
+    }
+
+    bool running = isCoprocessRunning();
+    if (*arguments != '-') {
+        if (*arguments == '\0') {
+            if (running) {
+                printf("%d: %s (%ld lines sent, %ld received)\n", coprocess.pid, coprocess.command,
+                       coprocess.linesSent, coprocess.linesReceived);
+            } else {
+                printf("No coprocess.\n");
+            }
+        } else if (running) {
+            printf("A coprocess is already running.\n");
+        } else {
+            startCoprocess(arguments);
+        }
+        return;
+    }
+
+    if (!running) {
+        printf("No coprocess.\n");
+    } else if (strncmp("-s ", arguments, 3) == 0) {
+        /* The line is sent with a newline in place of its terminator */
+        size_t length = strlen(arguments + 3);
+        arguments[3 + length] = '\n';
+        streamToCoprocess(arguments + 3, length + 1, 1);
+        arguments[3 + length] = '\0';
+    } else if (strncmp("-f ", arguments, 3) == 0) {
+        streamFileToCoprocess(arguments + 3);
+    } else if (strcmp("-k", arguments) == 0) {
+        finishCoprocess();
+    } else {
+        HELP();
+    }
+}
+
+/**
+ * Start a command as the coprocess, with pipes to its input and from its output. The coprocess is a
+ * concurrent job, so it is reaped like one. The ends of the pipes the shell keeps are closed on exec, so no
+ * other command holds the input of the coprocess open.
+ *
+ * @param commandLine The command
+ */
+void startCoprocess(char *commandLine)
+{
+    char **command = parseCommand(commandLine);
+    if (command == NULL) {
+        printf("Unterminated quote.\n");
+        return;
+    }
+    Pipeline pipeline;
+    if (!parsePipeline(command, &pipeline)) {
+        printf("Invalid pipeline.\n");
+        return;
+    }
+    if (pipeline.stageCount != 1 || pipeline.stages[0].inputFile != NULL || pipeline.stages[0].outputFile != NULL) {
+        printf("A coprocess must be a single command without redirections.\n");
+        freePipeline(&pipeline);
+        return;
+    }
+
+    int toCoprocess[2];
+    int fromCoprocess[2];
+    if (pipe2(toCoprocess, O_CLOEXEC) < 0) {
+        perror("pipe");
+        freePipeline(&pipeline);
+        return;
+    }
+    if (pipe2(fromCoprocess, O_CLOEXEC) < 0) {
+        perror("pipe");
+        close(toCoprocess[0]);
+        close(toCoprocess[1]);
+        freePipeline(&pipeline);
+        return;
+    }
+
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    pid_t pid = startPipelineStage(&pipeline.stages[0], toCoprocess[0], fromCoprocess[1], toCoprocess[1], 0);
+    close(toCoprocess[0]);
+    close(fromCoprocess[1]);
+    if (pid < 0) {
+        close(toCoprocess[1]);
+        close(fromCoprocess[0]);
+        freePipeline(&pipeline);
+        return;
+    }
+
+    pid_t *pids = malloc(sizeof(pid_t));
+    if (pids == NULL) {
+        printf("Error: malloc failed in startCoprocess\n");
+        exit(EXIT_FAILURE);
+    }
+    pids[0] = pid;
+    Job *job = addJob(pids, 1, jobControl ? pid : 0, joinCommand(command), false);
+    job->startTime = startTime;
+    job->historyIndex = (size_t) -1;
+    job->processNames[0] = strdup(pipeline.stages[0].arguments[0]);
+    freePipeline(&pipeline);
+
+    free(coprocess.command);
+    coprocess.pid = pid;
+    coprocess.command = strdup(job->command);
+    coprocess.inputDescriptor = toCoprocess[1];
+    coprocess.outputDescriptor = fromCoprocess[0];
+    coprocess.bufferLength = 0;
+    coprocess.linesSent = 0;
+    coprocess.linesReceived = 0;
+    if (interactive) {
+        printf("[%d] %d\n", job->number, pid);
+    }
+}
+
+/**
+ * Checks if the coprocess is still running. The pipes of a coprocess that has finished are closed.
+ *
+ * @return The coprocess is running
+ */
+bool isCoprocessRunning(void)
+{
+    if (coprocess.pid <= 0) {
+        return false;
+    }
+
+    for (int i = 0; i < jobTable.count; ++i) {
+        if (jobTable.jobs[i].pids[0] == coprocess.pid && jobTable.jobs[i].runningCount > 0) {
+            return true;
+        }
+    }
+    closeCoprocess();
+
+    return false;
+}
+
+/**
+ * Send lines to the coprocess and print a line of response for each of them. The lines are written while
+ * the responses are read, so neither pipe fills up and blocks the coprocess. Gives up when the coprocess
+ * has not answered for a while, which usually means it buffers its output.
+ *
+ * @param lines The lines, each ending with a newline
+ * @param length The length of the lines
+ * @param lineCount The amount of lines
+ * @return All responses were read
+ */
+bool streamToCoprocess(const char *lines, size_t length, long lineCount)
+{
+    int flags = fcntl(coprocess.inputDescriptor, F_GETFL);
+    fcntl(coprocess.inputDescriptor, F_SETFL, flags | O_NONBLOCK);
+
+    size_t written = 0;
+    long expectedLines = coprocess.linesReceived + lineCount;
+    bool answered = true;
+    while (answered && (written < length || coprocess.linesReceived < expectedLines)) {
+        struct pollfd descriptors[2] = {
+            { coprocess.outputDescriptor, POLLIN, 0 },
+            { written < length ? coprocess.inputDescriptor : -1, POLLOUT, 0 }
+        };
+        int ready = poll(descriptors, 2, COPROCESS_TIMEOUT_MS);
+        if (ready == 0) {
+            printf("No response from coprocess.\n");
+            answered = false;
+        } else if (ready < 0) {
+            answered = errno == EINTR;
+        }
+
+        if (descriptors[1].revents & (POLLERR | POLLHUP)) {
+            printf("Coprocess has closed its input.\n");
+            answered = false;
+        } else if (descriptors[1].revents & POLLOUT) {
+            ssize_t bytesWritten = write(coprocess.inputDescriptor, lines + written, length - written);
+            if (bytesWritten > 0) {
+                coprocess.linesSent += countLines(lines + written, bytesWritten);
+                written += bytesWritten;
+            }
+        }
+        if (descriptors[0].revents & (POLLIN | POLLHUP)) {
+            answered = answered && readFromCoprocess(expectedLines - coprocess.linesReceived) > 0;
+        }
+    }
+
+    fcntl(coprocess.inputDescriptor, F_SETFL, flags);
+    fflush(stdout);
+
+    return answered;
+}
+
+/**
+ * Send the lines of a file to the coprocess and print the responses.
+ *
+ * @param filename The file
+ */
+void streamFileToCoprocess(const char *filename)
+{
+    int fileDescriptor = open(filename, O_RDONLY);
+    struct stat fileStatus;
+    if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) < 0) {
+        perror(filename);
+        if (fileDescriptor >= 0) {
+            close(fileDescriptor);
+        }
+        return;
+    }
+    if (fileStatus.st_size == 0) {
+        close(fileDescriptor);
+        return;
+    }
+
+    char *lines = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+    if (lines == MAP_FAILED) {
+        perror(filename);
+        return;
+    }
+
+    bool answered = streamToCoprocess(lines, fileStatus.st_size, countLines(lines, fileStatus.st_size));
+    if (answered && lines[fileStatus.st_size - 1] != '\n') {
+        streamToCoprocess("\n", 1, 1);
+    }
+    munmap(lines, fileStatus.st_size);
+}
+
+/**
+ * Read what the coprocess has written and print up to a number of whole lines of it. The rest stays in the
+ * buffer until it is asked for.
+ *
+ * @param maxLines The most lines to print
+ * @return The amount of bytes read, 0 at the end of the output, or -1 on error
+ */
+ssize_t readFromCoprocess(long maxLines)
+{
+    if (coprocess.bufferLength == coprocess.bufferCapacity) {
+        coprocess.bufferCapacity = coprocess.bufferCapacity == 0 ? 65536 : coprocess.bufferCapacity * 2;
+        coprocess.buffer = realloc(coprocess.buffer, coprocess.bufferCapacity);
+        if (coprocess.buffer == NULL) {
+            printf("Error: realloc failed in readFromCoprocess\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ssize_t bytesRead = read(coprocess.outputDescriptor, coprocess.buffer + coprocess.bufferLength,
+                             coprocess.bufferCapacity - coprocess.bufferLength);
+    if (bytesRead <= 0) {
+        if (bytesRead == 0) {
+            printf("Coprocess has closed its output.\n");
+        }
+        return bytesRead < 0 && errno == EINTR ? 1 : bytesRead;
+    }
+    coprocess.bufferLength += bytesRead;
+
+    char *start = coprocess.buffer;
+    char *end = coprocess.buffer + coprocess.bufferLength;
+    char *newline;
+    while (maxLines > 0 && (newline = memchr(start, '\n', end - start)) != NULL) {
+        fwrite(start, 1, newline + 1 - start, stdout);
+        coprocess.linesReceived++;
+        maxLines--;
+        start = newline + 1;
+    }
+    coprocess.bufferLength -= start - coprocess.buffer;
+    memmove(coprocess.buffer, start, coprocess.bufferLength);
+
+    return bytesRead;
+}
+
+/**
+ * Close the input of the coprocess, print the rest of its output and wait for it to finish.
+ */
+void finishCoprocess(void)
+{
+    close(coprocess.inputDescriptor);
+    coprocess.inputDescriptor = -1;
+
+    fwrite(coprocess.buffer, 1, coprocess.bufferLength, stdout);
+    coprocess.bufferLength = 0;
+    ssize_t bytesRead;
+    char buffer[4096];
+    while ((bytesRead = read(coprocess.outputDescriptor, buffer, sizeof(buffer))) != 0) {
+        if (bytesRead > 0) {
+            fwrite(buffer, 1, bytesRead, stdout);
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+    fflush(stdout);
+
+    for (int i = 0; i < jobTable.count; ++i) {
+        Job *job = &jobTable.jobs[i];
+        while (job->pids[0] == coprocess.pid && job->runningCount > 0 && job->stoppedCount == 0) {
+            sigsuspend(&unblockedSignalMask);
+        }
+    }
+    closeCoprocess();
+}
+
+/**
+ * Close the pipes of the coprocess and forget it.
+ */
+void closeCoprocess(void)
+{
+    if (coprocess.inputDescriptor >= 0) {
+        close(coprocess.inputDescriptor);
+    }
+    if (coprocess.outputDescriptor >= 0) {
+        close(coprocess.outputDescriptor);
+    }
+    coprocess.inputDescriptor = -1;
+    coprocess.outputDescriptor = -1;
+    coprocess.bufferLength = 0;
+    coprocess.pid = 0;
+}
+
+/**
+ * Count the lines of a text.
+ *
+ * @param text The text
+ * @param length The length of the text
+ * @return The amount of newlines
+ */
+long countLines(const char *text, size_t length)
+{
+    long lineCount = 0;
+    const char *end = text + length;
+    while ((text = memchr(text, '\n', end - text)) != NULL) {
+        lineCount++;
+        text++;
+    }
+
+    return lineCount;
+}
+
+/**
+ * Read a line from the terminal with the line editor. The terminal is in raw mode while the line is edited,
+ * and the prompt is already printed.
+ *
+ * @param line Pointer to the buffer of the line, which is allocated or grown like with getline
+ * @param capacity Pointer to the capacity of the buffer
+ * @return The length of the line, which ends with a newline, or -1 at the end of the input
+ */
+ssize_t readEditedLine(char **line, size_t *capacity)
+{
+    struct termios originalAttributes;
+    if (tcgetattr(STDIN_FILENO, &originalAttributes) < 0) {
+        return getline(line, capacity, stdin);
+    }
+    struct termios rawAttributes = originalAttributes;
+    rawAttributes.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    rawAttributes.c_iflag &= ~(IXON | ICRNL);
+    rawAttributes.c_cc[VMIN] = 1;
+    rawAttributes.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &rawAttributes);
+
+    LineEditor editor = { *line, 0, *capacity, 0, 0, NULL };
+    reserveEditorSpace(&editor, 1);
+    fflush(stdout);
+
+    ssize_t result = 0;
+    bool previousKeyWasTab = false;
+    while (result == 0) {
+        unsigned char key;
+        ssize_t bytesRead = read(STDIN_FILENO, &key, 1);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        } else if (bytesRead <= 0) {
+            result = -1;
+            break;
+        }
+
+        bool keyIsTab = key == '\t';
+        switch (key) {
+        case '\r':
+        case '\n':
+            reserveEditorSpace(&editor, 1);
+            editor.text[editor.length++] = '\n';
+            editor.text[editor.length] = '\0';
+            printf("\n");
+            result = editor.length;
+            break;
+        case 3: /* Ctrl-C */
+            printf("^C\n%s", PROMPT_TEXT);
+            editor.length = 0;
+            editor.cursor = 0;
+            editor.historyOffset = 0;
+            break;
+        case 4: /* Ctrl-D */
+            if (editor.length == 0) {
+                result = -1;
+            } else {
+                deleteEditorText(&editor, editor.cursor, 1);
+            }
+            break;
+        case '\t':
+            completeWord(&editor, previousKeyWasTab);
+            break;
+        case 127:
+        case 8: /* Backspace and Ctrl-H */
+            if (editor.cursor > 0) {
+                editor.cursor--;
+                deleteEditorText(&editor, editor.cursor, 1);
+            }
+            break;
+        case 1: /* Ctrl-A */
+            editor.cursor = 0;
+            break;
+        case 5: /* Ctrl-E */
+            editor.cursor = editor.length;
+            break;
+        case 2: /* Ctrl-B */
+            editor.cursor -= editor.cursor > 0 ? 1 : 0;
+            break;
+        case 6: /* Ctrl-F */
+            editor.cursor += editor.cursor < editor.length ? 1 : 0;
+            break;
+        case 16: /* Ctrl-P */
+            browseHistory(&editor, 1);
+            break;
+        case 14: /* Ctrl-N */
+            browseHistory(&editor, -1);
+            break;
+        case 11: /* Ctrl-K */
+            editor.length = editor.cursor;
+            break;
+        case 21: /* Ctrl-U */
+            deleteEditorText(&editor, 0, editor.cursor);
+            editor.cursor = 0;
+            break;
+        case 23: /* Ctrl-W */
+            {
+                size_t wordStart = editor.cursor;
+                while (wordStart > 0 && editor.text[wordStart - 1] == ' ') {
+                    wordStart--;
+                }
+                while (wordStart > 0 && editor.text[wordStart - 1] != ' ') {
+                    wordStart--;
+                }
+                deleteEditorText(&editor, wordStart, editor.cursor - wordStart);
+                editor.cursor = wordStart;
+            }
+            break;
+        case 12: /* Ctrl-L */
+            printf("\x1b[H\x1b[2J");
+            break;
+        case 27: /* Escape sequence */
+            readEscapeSequence(&editor);
+            break;
+        default:
+            if (key >= 32) {
+                insertEditorText(&editor, (const char *) &key, 1);
+            }
+            break;
+        }
+        previousKeyWasTab = keyIsTab;
+
+        if (result == 0) {
+            refreshEditedLine(&editor);
+        }
+    }
+
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &originalAttributes);
+    fflush(stdout);
+    free(editor.typedLine);
+    *line = editor.text;
+    *capacity = editor.capacity;
+
+    return result;
+}
+
+/**
+ * Read the rest of an escape sequence of a key, and move the cursor or browse the history for it.
+ *
+ * @param editor The line editor
+ */
+void readEscapeSequence(LineEditor *editor)
+{
+    char sequence[3] = { 0, 0, 0 };
+    if (read(STDIN_FILENO, &sequence[0], 1) != 1 || read(STDIN_FILENO, &sequence[1], 1) != 1) {
+        return;
+    }
+    if (sequence[0] == '[' && isdigit((unsigned char) sequence[1])) {
+        if (read(STDIN_FILENO, &sequence[2], 1) != 1 || sequence[2] != '~') {
+            return;
+        }
+        if (sequence[1] == '3') {
+            deleteEditorText(editor, editor->cursor, 1);
+        } else if (sequence[1] == '1' || sequence[1] == '7') {
+            editor->cursor = 0;
+        } else if (sequence[1] == '4' || sequence[1] == '8') {
+            editor->cursor = editor->length;
+        }
+        return;
+    }
+    if (sequence[0] != '[' && sequence[0] != 'O') {
+        return;
+    }
+
+    switch (sequence[1]) {
+    case 'A':
+        browseHistory(editor, 1);
+        break;
+    case 'B':
+        browseHistory(editor, -1);
+        break;
+    case 'C':
+        editor->cursor += editor->cursor < editor->length ? 1 : 0;
+        break;
+    case 'D':
+        editor->cursor -= editor->cursor > 0 ? 1 : 0;
+        break;
+    case 'H':
+        editor->cursor = 0;
+        break;
+    case 'F':
+        editor->cursor = editor->length;
+        break;
+    }
+}
+
+/**
+ * Redraw the prompt and the line, and put the cursor in its place.
+ *
+ * @param editor The line editor
+ */
+void refreshEditedLine(LineEditor *editor)
+{
+    printf("\r%s%.*s\x1b[K", PROMPT_TEXT, (int) editor->length, editor->text);
+    if (editor->cursor < editor->length) {
+        printf("\x1b[%zuD", editor->length - editor->cursor);
+    }
+    fflush(stdout);
+}
+
+/**
+ * Make room for more text in the line, and its terminator.
+ *
+ * @param editor The line editor
+ * @param extra The length of the text to make room for
+ */
+void reserveEditorSpace(LineEditor *editor, size_t extra)
+{
+    if (editor->length + extra + 1 <= editor->capacity) {
+        return;
+    }
+
+    size_t capacity = editor->capacity == 0 ? 128 : editor->capacity;
+    while (capacity < editor->length + extra + 1) {
+        capacity *= 2;
+    }
+    editor->text = realloc(editor->text, capacity);
+    if (editor->text == NULL) {
+        printf("Error: realloc failed in reserveEditorSpace\n");
+        exit(EXIT_FAILURE);
+    }
+    editor->capacity = capacity;
+}
+
+/**
+ * Insert text at the cursor and move the cursor after it.
+ *
+ * @param editor The line editor
+ * @param text The text
+ * @param length The length of the text
+ */
+void insertEditorText(LineEditor *editor, const char *text, size_t length)
+{
+    reserveEditorSpace(editor, length);
+    memmove(editor->text + editor->cursor + length, editor->text + editor->cursor, editor->length - editor->cursor);
+    memcpy(editor->text + editor->cursor, text, length);
+    editor->length += length;
+    editor->cursor += length;
+}
+
+/**
+ * Delete text from the line. The cursor is not moved.
+ *
+ * @param editor The line editor
+ * @param start Where the text starts
+ * @param length The length of the text, which is cut at the end of the line
+ */
+void deleteEditorText(LineEditor *editor, size_t start, size_t length)
+{
+    if (start >= editor->length) {
+        return;
+    }
+    if (length > editor->length - start) {
+        length = editor->length - start;
+    }
+    memmove(editor->text + start, editor->text + start + length, editor->length - start - length);
+    editor->length -= length;
+}
+
+/**
+ * Replace the line with an older or newer command of the history. The line being typed is kept, and comes
+ * back after the most recent command.
+ *
+ * @param editor The line editor
+ * @param steps 1 for the older command, -1 for the newer one
+ */
+void browseHistory(LineEditor *editor, int steps)
+{
+    size_t count = countHistory();
+    size_t historyOffset = editor->historyOffset + steps;
+    if ((steps < 0 && editor->historyOffset == 0) || historyOffset > count) {
+        return;
+    }
+
+    if (editor->historyOffset == 0) {
+        free(editor->typedLine);
+        editor->typedLine = strndup(editor->text, editor->length);
+    }
+    editor->historyOffset = historyOffset;
+
+    const char *entry = editor->typedLine != NULL ? editor->typedLine : "";
+    size_t length = strlen(entry);
+    if (historyOffset > 0) {
+        entry = getHistoryEntry(count + 1 - historyOffset, &length);
+    }
+    editor->length = 0;
+    editor->cursor = 0;
+    insertEditorText(editor, entry, length);
+}
+
+/**
+ * Complete the word before the cursor. The first word of a command is completed with the executables of
+ * PATH and the builtins, and other words with file names. A word is completed as far as all its completions
+ * agree, and the completions are listed when that is no further on a second tab.
+ *
+ * @param editor The line editor
+ * @param listCompletions List the completions if the word can not be completed any further
+ */
+void completeWord(LineEditor *editor, bool listCompletions)
+{
+    size_t wordStart = editor->cursor;
+    while (wordStart > 0 && editor->text[wordStart - 1] != ' ' && editor->text[wordStart - 1] != '|') {
+        wordStart--;
+    }
+    size_t before = wordStart;
+    while (before > 0 && editor->text[before - 1] == ' ') {
+        before--;
+    }
+    bool commandWord = before == 0 || editor->text[before - 1] == '|';
+
+    char *word = strndup(editor->text + wordStart, editor->cursor - wordStart);
+    if (word == NULL) {
+        printf("Error: strndup failed in completeWord\n");
+        exit(EXIT_FAILURE);
+    }
+    CompletionList completions = { NULL, 0, 0 };
+    char *common;
+    size_t total;
+    if (commandWord && strchr(word, '/') == NULL) {
+        total = completeCommand(word, &completions, &common);
+    } else {
+        total = completeFileName(word, &completions, &common);
+    }
+
+    size_t wordLength = strlen(word);
+    size_t commonLength = strlen(common);
+    if (total == 0) {
+        printf("\a");
+    } else if (commonLength > wordLength) {
+        insertEditorText(editor, common + wordLength, commonLength - wordLength);
+    }
+    if (total == 1 && common[commonLength - 1] != '/') {
+        insertEditorText(editor, " ", 1);
+    } else if (total > 1 && commonLength == wordLength) {
+        if (!listCompletions) {
+            printf("\a");
+        } else if (completions.count == 0) {
+            printf("\n%zu possibilities\n", total);
+        } else {
+            printf("\n");
+            size_t column = 0;
+            for (size_t i = 0; i < completions.count; ++i) {
+                size_t nameLength = strlen(completions.names[i]);
+                if (column > 0 && column + nameLength + 2 > 80) {
+                    printf("\n");
+                    column = 0;
+                }
+                printf("%s  ", completions.names[i]);
+                column += nameLength + 2;
+            }
+            printf("\n");
+        }
+    }
+
+    free(common);
+    free(word);
+    freeCompletions(&completions);
+}
+
+/**
+ * Find the executables of PATH and the builtins that start with a prefix. The tries of the directories
+ * count their names, so the completions are only listed when there are few enough of them.
+ *
+ * @param prefix The prefix
+ * @param completions The completions, sorted and without duplicates, unless there are too many
+ * @param common Pointer to the allocated longest prefix shared by the completions
+ * @return The amount of completions
+ */
+size_t completeCommand(const char *prefix, CompletionList *completions, char **common)
+{
+    static const char *builtins[] = { "bg", "coproc", "exit", "fg", "hash", "help", "history", "jobs", "time",
+                                      "wait" };
+    size_t prefixLength = strlen(prefix);
+    CompletionDirectory **directories = refreshCompletionDirectories();
+
+    size_t total = 0;
+    for (size_t i = 0; directories[i] != NULL; ++i) {
+        int node = findTrieNode(&directories[i]->trie, prefix);
+        total += node >= 0 ? directories[i]->trie.nodes[node].nameCount : 0;
+    }
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); ++i) {
+        if (strncmp(builtins[i], prefix, prefixLength) == 0) {
+            addCompletion(completions, builtins[i]);
+            total++;
+        }
+    }
+
+    if (total <= COMPLETION_LIST_LIMIT) {
+        char name[NAME_MAX + 1];
+        for (size_t i = 0; directories[i] != NULL; ++i) {
+            int node = findTrieNode(&directories[i]->trie, prefix);
+            if (node >= 0) {
+                memcpy(name, prefix, prefixLength);
+                collectTrieNames(&directories[i]->trie, node, name, prefixLength, completions);
+            }
+        }
+        free(directories);
+        return finishCompletions(completions, prefix, common);
+    }
+
+    freeCompletions(completions);
+    *common = NULL;
+    for (size_t i = 0; directories[i] != NULL; ++i) {
+        int node = findTrieNode(&directories[i]->trie, prefix);
+        if (node < 0 || directories[i]->trie.nodes[node].nameCount == 0) {
+            continue;
+        }
+        char name[NAME_MAX + 1];
+        memcpy(name, prefix, prefixLength);
+        size_t length = extendTriePrefix(&directories[i]->trie, node, name, prefixLength);
+        if (*common == NULL) {
+            *common = strndup(name, length);
+        } else {
+            size_t shared = 0;
+            while ((*common)[shared] != '\0' && shared < length && (*common)[shared] == name[shared]) {
+                shared++;
+            }
+            (*common)[shared] = '\0';
+        }
+    }
+    free(directories);
+    if (*common == NULL) {
+        printf("Error: strndup failed in completeCommand\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return total;
+}
+
+/**
+ * Find the files whose path starts with a word. Directories end with a slash, and hidden files are only
+ * found when the name in the word starts with a dot.
+ *
+ * @param word The word
+ * @param completions The completions, sorted
+ * @param common Pointer to the allocated longest prefix shared by the completions
+ * @return The amount of completions
+ */
+size_t completeFileName(const char *word, CompletionList *completions, char **common)
+{
+    const char *slash = strrchr(word, '/');
+    size_t directoryLength = slash != NULL ? (size_t) (slash - word) + 1 : 0;
+    const char *namePrefix = word + directoryLength;
+    size_t namePrefixLength = strlen(namePrefix);
+
+    char *directoryName = directoryLength > 0 ? strndup(word, directoryLength) : strdup(".");
+    DIR *directory = directoryName != NULL ? opendir(directoryName) : NULL;
+    if (directory != NULL) {
+        struct dirent *entry;
+        char path[PATH_MAX];
+        while ((entry = readdir(directory)) != NULL) {
+            if (strncmp(entry->d_name, namePrefix, namePrefixLength) != 0
+                || (entry->d_name[0] == '.' && namePrefix[0] != '.')
+                || strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            struct stat fileStatus;
+            bool isDirectory = entry->d_type == DT_DIR
+                               || ((entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+                                   && fstatat(dirfd(directory), entry->d_name, &fileStatus, 0) == 0
+                                   && S_ISDIR(fileStatus.st_mode));
+            snprintf(path, sizeof(path), "%.*s%s%s", (int) directoryLength, word, entry->d_name,
+                     isDirectory ? "/" : "");
+            addCompletion(completions, path);
+        }
+        closedir(directory);
+    }
+    free(directoryName);
+
+    return finishCompletions(completions, word, common);
+}
+
+/**
+ * Get the tries of the directories of PATH, and read the directories that have not been read or have been
+ * changed since. A directory that is the same as an earlier one in PATH is left out.
+ *
+ * @return The allocated list of the directories, which ends with NULL
+ */
+CompletionDirectory **refreshCompletionDirectories(void)
+{
+    const char *searchPath = getenv("PATH");
+    if (searchPath == NULL) {
+        searchPath = "/bin:/usr/bin";
+    }
+
+    size_t directoryCount = 1;
+    for (const char *separator = searchPath; *separator != '\0'; ++separator) {
+        directoryCount += *separator == ':';
+    }
+    CompletionDirectory **directories = calloc(directoryCount + 1, sizeof(CompletionDirectory *));
+    struct stat *directoryStatuses = calloc(directoryCount, sizeof(struct stat));
+    if (directories == NULL || directoryStatuses == NULL) {
+        printf("Error: calloc failed in refreshCompletionDirectories\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t found = 0;
+    const char *start = searchPath;
+    while (true) {
+        const char *end = strchr(start, ':');
+        size_t length = end != NULL ? (size_t) (end - start) : strlen(start);
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%.*s", (int) (length > 0 ? length : 1), length > 0 ? start : ".");
+
+        struct stat *status = &directoryStatuses[found];
+        bool seen = stat(path, status) != 0 || !S_ISDIR(status->st_mode);
+        for (size_t i = 0; i < found && !seen; ++i) {
+            seen = directoryStatuses[i].st_dev == status->st_dev && directoryStatuses[i].st_ino == status->st_ino;
+        }
+        if (!seen) {
+            CompletionDirectory *directory = findCompletionDirectory(path);
+            if (!directory->loaded || directory->modificationTime.tv_sec != status->st_mtim.tv_sec
+                || directory->modificationTime.tv_nsec != status->st_mtim.tv_nsec) {
+                loadCompletionDirectory(directory);
+                directory->modificationTime = status->st_mtim;
+            }
+            directories[found++] = directory;
+        }
+
+        if (end == NULL) {
+            break;
+        }
+        start = end + 1;
+    }
+    free(directoryStatuses);
+
+    return directories;
+}
+
+/**
+ * Find the cached directory with a path, adding a directory that has not been read if there is none.
+ *
+ * @param path The path of the directory
+ * @return The directory
+ */
+CompletionDirectory *findCompletionDirectory(const char *path)
+{
+    for (size_t i = 0; i < completionCache.count; ++i) {
+        if (strcmp(completionCache.directories[i].path, path) == 0) {
+            return &completionCache.directories[i];
+        }
+    }
+
+    if (completionCache.count == completionCache.capacity) {
+        completionCache.capacity = completionCache.capacity == 0 ? 16 : completionCache.capacity * 2;
+        completionCache.directories = realloc(completionCache.directories,
+                                              completionCache.capacity * sizeof(CompletionDirectory));
+        if (completionCache.directories == NULL) {
+            printf("Error: realloc failed in findCompletionDirectory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    CompletionDirectory *directory = &completionCache.directories[completionCache.count++];
+    memset(directory, 0, sizeof(CompletionDirectory));
+    directory->path = strdup(path);
+    if (directory->path == NULL) {
+        printf("Error: strdup failed in findCompletionDirectory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return directory;
+}
+
+/**
+ * Read the executable files of a directory into its trie.
+ *
+ * @param directory The directory
+ */
+void loadCompletionDirectory(CompletionDirectory *directory)
+{
+    directory->trie.count = 0;
+    addTrieNode(&directory->trie, '\0');
+    directory->loaded = true;
+
+    DIR *stream = opendir(directory->path);
+    if (stream == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(stream)) != NULL) {
+        struct stat fileStatus;
+        if (entry->d_name[0] != '.' && entry->d_type != DT_DIR
+            && fstatat(dirfd(stream), entry->d_name, &fileStatus, 0) == 0 && S_ISREG(fileStatus.st_mode)
+            && (fileStatus.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) != 0) {
+            addToTrie(&directory->trie, entry->d_name);
+        }
+    }
+    closedir(stream);
+}
+
+/**
+ * Add a node to the nodes of a trie, without linking it to a parent.
+ *
+ * @param trie The trie
+ * @param label The character of the node
+ * @return The index of the node
+ */
+int addTrieNode(Trie *trie, char label)
+{
+    if (trie->count == trie->capacity) {
+        trie->capacity = trie->capacity == 0 ? 1024 : trie->capacity * 2;
+        trie->nodes = realloc(trie->nodes, trie->capacity * sizeof(TrieNode));
+        if (trie->nodes == NULL) {
+            printf("Error: realloc failed in addTrieNode\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    TrieNode *node = &trie->nodes[trie->count];
+    node->label = label;
+    node->terminal = false;
+    node->firstChild = -1;
+    node->nextSibling = -1;
+    node->nameCount = 0;
+
+    return trie->count++;
+}
+
+/**
+ * Add a name to a trie, and count it in every node on its way.
+ *
+ * @param trie The trie, which has a root
+ * @param name The name
+ */
+void addToTrie(Trie *trie, const char *name)
+{
+    int path[NAME_MAX + 1];
+    int depth = 0;
+    int node = 0;
+    path[depth++] = node;
+    for (const char *character = name; *character != '\0' && depth <= NAME_MAX; ++character) {
+        int child = trie->nodes[node].firstChild;
+        while (child >= 0 && trie->nodes[child].label != *character) {
+            child = trie->nodes[child].nextSibling;
+        }
+        if (child < 0) {
+            child = addTrieNode(trie, *character);
+            trie->nodes[child].nextSibling = trie->nodes[node].firstChild;
+            trie->nodes[node].firstChild = child;
+        }
+        node = child;
+        path[depth++] = node;
+    }
+
+    if (!trie->nodes[node].terminal) {
+        trie->nodes[node].terminal = true;
+        for (int i = 0; i < depth; ++i) {
+            trie->nodes[path[i]].nameCount++;
+        }
+    }
+}
+
+/**
+ * Find the node of a trie where a prefix ends.
+ *
+ * @param trie The trie
+ * @param prefix The prefix
+ * @return The index of the node, or -1 if no name starts with the prefix
+ */
+int findTrieNode(Trie *trie, const char *prefix)
+{
+    if (trie->count == 0) {
+        return -1;
+    }
+
+    int node = 0;
+    for (const char *character = prefix; *character != '\0' && node >= 0; ++character) {
+        node = trie->nodes[node].firstChild;
+        while (node >= 0 && trie->nodes[node].label != *character) {
+            node = trie->nodes[node].nextSibling;
+        }
+    }
+
+    return node;
+}
+
+/**
+ * Add every name below a node of a trie to the completions.
+ *
+ * @param trie The trie
+ * @param node The node
+ * @param name The name up to and including the node, with room for the longest name
+ * @param length The length of the name
+ * @param completions The completions
+ */
+void collectTrieNames(Trie *trie, int node, char *name, size_t length, CompletionList *completions)
+{
+    if (trie->nodes[node].terminal) {
+        name[length] = '\0';
+        addCompletion(completions, name);
+    }
+    for (int child = trie->nodes[node].firstChild; child >= 0 && length < NAME_MAX;
+         child = trie->nodes[child].nextSibling) {
+        name[length] = trie->nodes[child].label;
+        collectTrieNames(trie, child, name, length + 1, completions);
+    }
+}
+
+/**
+ * Extend a prefix as far as every name below its node of a trie agrees.
+ *
+ * @param trie The trie
+ * @param node The node where the prefix ends
+ * @param name The prefix, with room for the longest name
+ * @param length The length of the prefix
+ * @return The length of the extended prefix
+ */
+size_t extendTriePrefix(Trie *trie, int node, char *name, size_t length)
+{
+    while (!trie->nodes[node].terminal && trie->nodes[node].firstChild >= 0
+           && trie->nodes[trie->nodes[node].firstChild].nextSibling < 0 && length < NAME_MAX) {
+        node = trie->nodes[node].firstChild;
+        name[length++] = trie->nodes[node].label;
+    }
+
+    return length;
+}
+
+/**
+ * Add a copy of a name to the completions.
+ *
+ * @param completions The completions
+ * @param name The name
+ */
+void addCompletion(CompletionList *completions, const char *name)
+{
+    if (completions->count == completions->capacity) {
+        completions->capacity = completions->capacity == 0 ? 64 : completions->capacity * 2;
+        completions->names = realloc(completions->names, completions->capacity * sizeof(char *));
+        if (completions->names == NULL) {
+            printf("Error: realloc failed in addCompletion\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    completions->names[completions->count] = strdup(name);
+    if (completions->names[completions->count] == NULL) {
+        printf("Error: strdup failed in addCompletion\n");
+        exit(EXIT_FAILURE);
+    }
+    completions->count++;
+}
+
+/**
+ * Sort the completions, remove the duplicates and find the longest prefix they share, which is the word
+ * itself when there are none.
+ *
+ * @param completions The completions
+ * @param word The completed word
+ * @param common Pointer to the allocated longest shared prefix
+ * @return The amount of completions
+ */
+size_t finishCompletions(CompletionList *completions, const char *word, char **common)
+{
+    qsort(completions->names, completions->count, sizeof(char *), compareNames);
+    size_t unique = 0;
+    for (size_t i = 0; i < completions->count; ++i) {
+        if (unique > 0 && strcmp(completions->names[unique - 1], completions->names[i]) == 0) {
+            free(completions->names[i]);
+        } else {
+            completions->names[unique++] = completions->names[i];
+        }
+    }
+    completions->count = unique;
+
+    if (unique == 0) {
+        *common = strdup(word);
+    } else {
+        const char *first = completions->names[0];
+        const char *last = completions->names[unique - 1];
+        size_t shared = 0;
+        while (first[shared] != '\0' && first[shared] == last[shared]) {
+            shared++;
+        }
+        *common = strndup(first, shared);
+    }
+    if (*common == NULL) {
+        printf("Error: strdup failed in finishCompletions\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return unique;
+}
+
+/**
+ * Orders names like strcmp.
+ *
+ * @param first The first name
+ * @param second The second name
+ * @return Negative, zero or positive like strcmp
+ */
+int compareNames(const void *first, const void *second)
+{
+    return strcmp(*(char *const *) first, *(char *const *) second);
+}
+
+/**
+ * Deallocate memory for completions.
+ *
+ * @param completions The completions
+ */
+void freeCompletions(CompletionList *completions)
+{
+    for (size_t i = 0; i < completions->count; ++i) {
+        free(completions->names[i]);
+    }
+    free(completions->names);
+    completions->names = NULL;
+    completions->count = 0;
+    completions->capacity = 0;
+}
+
+/**
+ * Wait for every job of a script to finish, print the wall time of the script and the CPU time of its
+ * commands to stderr, and exit.
+ *
+ * @param startTime When the script started
+ */
+void finishScript(struct timespec *startTime)
+{
+    waitForAllJobs();
+
+    struct timespec endTime;
+    clock_gettime(CLOCK_MONOTONIC, &endTime);
+    double wallSeconds = (endTime.tv_sec - startTime->tv_sec) + (endTime.tv_nsec - startTime->tv_nsec) / 1e9;
+    double userSeconds = commandTotals.userTime.tv_sec + commandTotals.userTime.tv_usec / 1e6;
+    double systemSeconds = commandTotals.systemTime.tv_sec + commandTotals.systemTime.tv_usec / 1e6;
+    fprintf(stderr, "Wall time: %.3f s, CPU time of commands: %.3f s (%.3f s user, %.3f s sys)\n",
+            wallSeconds, userSeconds + systemSeconds, userSeconds, systemSeconds);
+    exit(EXIT_SUCCESS);
 }
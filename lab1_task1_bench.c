@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <time.h>
+#include <spawn.h>
+
+#define MAX_BALLAST_SIZES 16
+#define HELP() printf("-----------------------------------\
+\nThis is a benchmark of the latency of starting a command with fork and execvp, the way SamSh does with -F,\n"\
+"against posix_spawnp, while the benchmark holds a ballast of touched memory like a shell with a big\n"\
+"address space.\n\n"\
+"Usage:\n\t[main.c] [-n launches] [-m megabytes] [command] [arguments]\n\n" \
+"\t-n launches\n\t\tLaunches of each backend for each ballast, defaults to 1000\n" \
+"\t-m megabytes\n\t\tComma separated ballast sizes, defaults to 0,256\n" \
+"\tcommand\n\t\tThe command to start, defaults to true\n\n" \
+"\tExample:\n\t\tmain.c -n 500 -m 0,1024 /bin/true\n-----------------------------------\n")
+
+typedef pid_t (*LaunchBackend)(char **command);
+
+pid_t launchWithFork(char **command);
+pid_t launchWithSpawn(char **command);
+void measureLaunches(const char *backendName, LaunchBackend launch, char **command, int launches,
+                     long ballastMegabytes);
+int compareDoubles(const void *first, const void *second);
+double secondsSince(struct timespec *start);
+
+extern char **environ;
+
+/**
+ * Measures how long it takes to start and reap a command with each launch backend.
+ *
+ * @param argc Arguments count
+ * @param argv Arguments
+ * @return Status code
+ */
+int main(int argc, char **argv)
+{
+    int launches = 1000;
+    long ballastSizes[MAX_BALLAST_SIZES] = { 0, 256 };
+    int ballastCount = 2;
+    char *defaultCommand[] = { "true", NULL };
+
+    int option;
+    while ((option = getopt(argc, argv, "n:m:")) != -1) {
+        if (option == 'n') {
+            launches = atoi(optarg);
+            if (launches < 1) {
+                printf("%s is not a valid amount of launches, exiting..\n", optarg);
+                return 1;
+            }
+        } else if (option == 'm') {
+            char *pointerToEndOfSize;
+            ballastCount = 0;
+            char *size = strtok_r(optarg, ",", &pointerToEndOfSize);
+            while (size != NULL && ballastCount < MAX_BALLAST_SIZES) {
+                ballastSizes[ballastCount++] = atol(size);
+                size = strtok_r(NULL, ",", &pointerToEndOfSize);
+            }
+        } else {
+            HELP();
+            return 1;
+        }
+    }
+    char **command = optind < argc ? &argv[optind] : defaultCommand;
+
+    printf("backend,ballast_mb,launches,mean_us,p50_us,p99_us\n");
+    for (int i = 0; i < ballastCount; ++i) {
+        char *ballast = NULL;
+        size_t ballastSize = (size_t) ballastSizes[i] << 20;
+        if (ballastSize > 0) {
+            ballast = malloc(ballastSize);
+            if (ballast == NULL) {
+                printf("Error: malloc failed in main\n");
+                exit(EXIT_FAILURE);
+            }
+            memset(ballast, 1, ballastSize);
+        }
+
+        measureLaunches("fork", launchWithFork, command, launches, ballastSizes[i]);
+        measureLaunches("posix_spawn", launchWithSpawn, command, launches, ballastSizes[i]);
+        free(ballast);
+    }
+
+    return 0;
+}
+
+/**
+ * Starts a command with fork and execvp.
+ *
+ * @param command The command and its arguments
+ * @return The pid of the child process, or -1 if it could not be started
+ */
+pid_t launchWithFork(char **command)
+{
+    pid_t pid;
+
+    pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Fork Failed");
+        return -1;
+    } else if (pid == 0) { /* child process */
+        execvp(command[0], command);
+        _exit(127);
+    } else { /* parent process */
+        return pid;
+    }
+}
+
+/**
+ * Starts a command with posix_spawnp.
+ *
+ * @param command The command and its arguments
+ * @return The pid of the child process, or -1 if it could not be started
+ */
+pid_t launchWithSpawn(char **command)
+{
+    pid_t pid;
+    int error = posix_spawnp(&pid, command[0], NULL, NULL, command, environ);
+    if (error != 0) {
+        fprintf(stderr, "%s: %s\n", command[0], strerror(error));
+        return -1;
+    }
+
+    return pid;
+}
+
+/**
+ * Starts and reaps a command repeatedly with a launch backend and prints the mean, median and 99th
+ * percentile latency.
+ *
+ * @param backendName The name of the backend
+ * @param launch The backend
+ * @param command The command and its arguments
+ * @param launches The amount of launches
+ * @param ballastMegabytes The size of the ballast held while launching
+ */
+void measureLaunches(const char *backendName, LaunchBackend launch, char **command, int launches,
+                     long ballastMegabytes)
+{
+    double *latencies = malloc(launches * sizeof(double));
+    if (latencies == NULL) {
+        printf("Error: malloc failed in measureLaunches\n");
+        exit(EXIT_FAILURE);
+    }
+
+    double total = 0;
+    for (int i = 0; i < launches; ++i) {
+        struct timespec startTime;
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+        pid_t pid = launch(command);
+        if (pid < 0) {
+            free(latencies);
+            return;
+        }
+        waitpid(pid, NULL, 0);
+        latencies[i] = secondsSince(&startTime) * 1e6;
+        total += latencies[i];
+    }
+
+    qsort(latencies, launches, sizeof(double), compareDoubles);
+    printf("%s,%ld,%d,%.1f,%.1f,%.1f\n", backendName, ballastMegabytes, launches, total / launches,
+           latencies[launches / 2], latencies[(int) (launches * 0.99)]);
+    free(latencies);
+}
+
+/**
+ * Orders doubles in ascending order.
+ *
+ * @param first The first double
+ * @param second The second double
+ * @return Negative, zero or positive like strcmp
+ */
+int compareDoubles(const void *first, const void *second)
+{
+    double difference = *(const double *) first - *(const double *) second;
+
+    return (difference > 0) - (difference < 0);
+}
+
+/**
+ * Gets the seconds passed since a point in time on the monotonic clock.
+ *
+ * @param start The point in time
+ * @return The seconds passed
+ */
+double secondsSince(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
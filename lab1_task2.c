@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -5,22 +7,304 @@
 #include <stdbool.h>
 #include <sys/wait.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <limits.h>
+#include <signal.h>
+#include <getopt.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAS_X86_KERNELS
+#endif
 
-#define SEARCH_PROCESSES 4
-#define TEXT_BUFFER_SIZE 512
+#define RESULT_BATCH_SIZE 128
+#define STREAM_CHUNK_SIZE (1 << 20)
+#define STREAM_SLOTS_PER_WORKER 2
+#define TRIGRAM_INDEX_MAGIC "LAB1TRI1"
+#define TRIGRAM_INDEX_SUFFIX ".tri"
+#define TRIGRAM_COUNT (1 << 24)
+#define MATCH_FOLDED_CASE 1
+#define MATCH_WHOLE_WORD 2
+#define OUTPUT_MATCHES 0
+#define OUTPUT_COUNT 1
+#define OUTPUT_EXISTS 2
 #define HELP() printf("-----------------------------------\
 \nThis is a script that searches a textfile using child processes.\n\n"\
-"Usage:\n\t[main.c] [filename] [\"searchstring\"] \n\n" \
+"Usage:\n\t[main.c] [-m] [-i] [-w] [-j processes] [-k kernel] [filename] [\"searchstring\"] \n" \
+"\t[main.c] [-m] [-i] [-w] [-j processes] -f [patternfile] [filename] \n" \
+"\t[main.c] index [filename] \n\n" \
+"\tindex\n\t\tBuild a trigram index of the file, stored next to it as filename.tri\n" \
+"\t-m\n\t\tMemory-map the file and search it in place, without copying rows\n" \
+"\t-s\n\t\tStream the file in fixed-size chunks with constant memory use, - reads from stdin.\n" \
+"\t\tThe text shown for a match ends at the end of its chunk\n" \
+"\t-j processes\n\t\tAmount of search processes, or search threads with -s, defaults to the amount of online CPUs\n" \
+"\t-k kernel\n\t\tSearch kernel: auto, avx2, sse2 or scalar, defaults to auto\n" \
+"\t-i\n\t\tIgnore the case of ASCII letters\n" \
+"\t-w\n\t\tOnly match whole words, not preceded or followed by a letter, digit or underscore. Not with -s\n" \
+"\t-f patternfile\n\t\tSearch for every pattern in the file, one pattern per line, in a single pass\n" \
+"\t-x\n\t\tOnly search the rows the trigram index lists as candidates, when the index is up to date\n" \
+"\t-t\n\t\tPrint the wall and CPU time of each search process or thread to stderr\n" \
+"\t--count\n\t\tOnly print the amount of matches\n" \
+"\t--exists\n\t\tOnly print if there is a match, and exit with 1 if there is none\n" \
+"\t--max N\n\t\tStop after the first N matches, or count at most N with --count\n\n" \
 "\tExample:\n\t\tmain.c textfile.txt \"findthistext\" \n-----------------------------------\n")
 
+typedef struct {
+    const char *data;
+    size_t size;
+} MappedFile;
+
+/* Header of a trigram index file. The header is followed by the offset of each row in the source file, the
+ * entries of the trigrams that occur in it sorted by trigram, and the posting lists of the entries. A
+ * posting list holds the rows a trigram occurs in as varint encoded differences to the previous row. */
+typedef struct {
+    char magic[8];
+    uint64_t sourceSize;
+    int64_t sourceModifiedSeconds;
+    int64_t sourceModifiedNanoseconds;
+    uint64_t rowsCount;
+    uint64_t trigramCount;
+    uint64_t postingsSize;
+    uint64_t reserved;
+} TrigramIndexHeader;
+
+typedef struct {
+    uint32_t trigram;
+    uint32_t rowCount;
+    uint64_t postingOffset;
+} TrigramEntry;
+
+/* A mapped trigram index file. */
+typedef struct {
+    MappedFile mapping;
+    const TrigramIndexHeader *header;
+    const uint64_t *rowOffsets;
+    const TrigramEntry *entries;
+    const unsigned char *postings;
+} TrigramIndex;
+
+/* A file loaded into a single buffer, with the offset of the start of each row in one contiguous array. */
+typedef struct {
+    char *text;
+    size_t size;
+    size_t *rowOffsets;
+    long rowsCount;
+} IndexedText;
+
+/* A match found by a search process. The row is relative to the first row of the process, and the text
+ * points into memory the parent shares with the process, so only the record itself goes through the pipe.
+ * The last record of each process has no text and holds the amount of rows it searched as row, or -1 if it
+ * stopped early, and the amount of matches it found as column. */
+typedef struct {
+    long row;
+    long column;
+    const char *text;
+    size_t textLength;
+} SearchMatch;
+
+typedef struct {
+    SearchMatch *matches;
+    size_t count;
+    size_t capacity;
+} MatchList;
+
+/* Batches the matches of a search process into its result pipe, or of a search thread into a match list. */
+typedef struct {
+    int resultPipe;
+    MatchList *collectedMatches;
+    long matchesFound;
+    int matchCount;
+    SearchMatch matches[RESULT_BATCH_SIZE];
+} ResultWriter;
+
+typedef struct {
+    double wallSeconds;
+    double cpuSeconds;
+} WorkerTime;
+
+typedef struct {
+    pid_t pid;
+    int resultPipe;
+    bool finished;
+    struct timespec startTime;
+    WorkerTime time;
+    long rowsSearched;
+    long matchesCounted;
+    MatchList pendingMatches;
+    char partialRecord[sizeof(SearchMatch)];
+    size_t partialLength;
+} SearchWorker;
+
+/* Aho-Corasick automaton over a set of patterns. Bytes are mapped to classes of bytes that occur in the
+ * patterns, so the transition table only has a column for each class instead of one for each byte. Each
+ * state has the first state on its suffix chain that ends a pattern, and those states link to the next.
+ * When folding case, upper case letters share the class of their lower case letter. */
+typedef struct {
+    int stateCount;
+    int classCount;
+    uint16_t byteClass[256];
+    int32_t *transitions;
+    int32_t *patternEnding;
+    int32_t *firstOutput;
+    int32_t *nextOutput;
+    size_t *patternLengths;
+    size_t longestPattern;
+    int patternCount;
+    int matchRules;
+} PatternAutomaton;
+
+typedef struct SearchPattern SearchPattern;
+
+/* A search kernel reports every occurrence of the pattern in a byte range and returns the amount of rows
+ * in the range. */
+typedef long (*SearchKernel)(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                             ResultWriter *writer);
+
+/* What to search for: a single needle, or a set of patterns in an automaton. The needle and patterns are
+ * folded to lower case when the matching rules fold case. */
+struct SearchPattern {
+    const char *needle;
+    size_t needleLength;
+    PatternAutomaton *automaton;
+    SearchKernel searchKernel;
+    int matchRules;
+};
+
+/* The scan position of a search kernel inside a byte range. The automaton only reports patterns ending at
+ * or after reportFrom, when it is set. */
+typedef struct {
+    const char *needle;
+    size_t needleLength;
+    const char *rangeEnd;
+    long row;
+    const char *rowStart;
+    ResultWriter *writer;
+    const char *reportFrom;
+} ScanState;
 
-int countRowsInFile(FILE *filePointer);
-bool unevenRowCount(int rowsCount);
-void calculateRowCounters(int *rowsCount, int *rowsToAdd, int *rowsForEachProcess, bool shouldAddRows);
-char **allocateTextRowsMemory(int rowsCount);
-void loadTextRows(FILE *filePointer, char **textRows, bool shouldAddRows, int rowsToAdd);
-void delegateSearchToChildProcesses(int rowsForEachProcess, char **textRows, char *searchString);
-int searchTextWithChildProcess(char **rowsToSearch, int startingRow, int rowCount, char searchString[]);
+/* A slot of the stream ring buffer. The data is the end of the previous chunk, long enough to hold every
+ * match crossing into this chunk but one byte short of holding a whole match, followed by the chunk. */
+typedef struct {
+    char *data;
+    size_t carryLength;
+    size_t length;
+    long carryNewlines;
+    long chunkNewlines;
+    size_t bytesAfterLastNewline;
+    long matchCount;
+    MatchList matches;
+    sem_t searched;
+} StreamSlot;
+
+/* Ring buffer of chunks shared by the reading thread and the search threads. */
+typedef struct {
+    StreamSlot *slots;
+    int slotCount;
+    SearchPattern *pattern;
+    sem_t filledSlots;
+    pthread_mutex_t claimLock;
+    long nextChunk;
+    long chunkCount;
+    bool readingFinished;
+    bool cancelled;
+} StreamRing;
+
+bool reportWorkerTimes = false;
+int outputMode = OUTPUT_MATCHES;
+long matchLimit = LONG_MAX;
+long matchesFound = 0;
+
+int searchFileByRows(char *filename, SearchPattern *pattern, int processCount);
+bool loadTextFile(char *filename, IndexedText *indexedText);
+void buildRowIndex(IndexedText *indexedText);
+void freeIndexedText(IndexedText *indexedText);
+void delegateSearchToChildProcesses(int processCount, IndexedText *indexedText, SearchPattern *pattern);
+int searchTextWithChildProcess(SearchWorker *worker, IndexedText *indexedText, long firstRow, long rowCount,
+                               SearchPattern *pattern);
+int searchFileInPlace(char *filename, SearchPattern *pattern, int processCount);
+bool mapFile(char *filename, MappedFile *mappedFile);
+void unmapFile(MappedFile *mappedFile);
+void splitMappedFile(MappedFile *mappedFile, size_t *rangeOffsets, int processCount);
+void delegateRangeSearchToChildProcesses(MappedFile *mappedFile, SearchPattern *pattern, int processCount);
+int searchRangeWithChildProcess(SearchWorker *worker, const char *rangeStart, const char *rangeEnd,
+                                SearchPattern *pattern);
+SearchKernel selectSearchKernel(char *kernelName, int matchRules);
+void foldCaseInPlace(char *text);
+bool foldedEquals(const char *text, const char *foldedNeedle, size_t needleLength);
+const char *findFolded(const char *start, const char *end, const char *foldedNeedle, size_t needleLength);
+bool isWholeWord(const char *rowStart, const char *rangeEnd, const char *occurrence, size_t length);
+bool isWordByte(unsigned char byte);
+long searchRangeScalar(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                       ResultWriter *writer);
+long searchRangeFoldedScalar(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                             ResultWriter *writer);
+long searchRangeWordScalar(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                           ResultWriter *writer);
+long searchRangeFoldedWordScalar(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                                 ResultWriter *writer);
+long searchRangeSse2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                     ResultWriter *writer);
+long searchRangeFoldedSse2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                           ResultWriter *writer);
+long searchRangeWordSse2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                         ResultWriter *writer);
+long searchRangeFoldedWordSse2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                               ResultWriter *writer);
+long searchRangeAvx2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                     ResultWriter *writer);
+long searchRangeFoldedAvx2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                           ResultWriter *writer);
+long searchRangeWordAvx2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                         ResultWriter *writer);
+long searchRangeFoldedWordAvx2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                               ResultWriter *writer);
+long searchRangeAutomaton(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                          ResultWriter *writer);
+void reportOccurrence(ScanState *state, const char *occurrence);
+void scanWithAutomaton(ScanState *state, const PatternAutomaton *automaton, const char *start, const char *end);
+bool loadPatterns(char *filename, char ***patterns, int *patternCount);
+PatternAutomaton *buildPatternAutomaton(char **patterns, int patternCount, int matchRules);
+void freePatternAutomaton(PatternAutomaton *automaton);
+pid_t startSearchWorker(SearchWorker *worker);
+void reportMatch(ResultWriter *writer, long row, long column, const char *text, size_t textLength);
+void finishResults(ResultWriter *writer, long rowsSearched);
+void flushResults(ResultWriter *writer);
+void collectSearchResults(SearchWorker *workers, int processCount);
+void readSearchResults(SearchWorker *worker);
+void cancelSearchWorkers(SearchWorker *workers, int processCount);
+void appendMatch(MatchList *matchList, SearchMatch *match);
+bool emitMatch(SearchMatch *match, long startingRow);
+bool addMatchCount(long count);
+void printMatch(SearchMatch *match, long startingRow);
+int searchStream(char *filename, SearchPattern *pattern, int threadCount);
+size_t longestPatternLength(SearchPattern *pattern);
+ssize_t readChunk(int fileDescriptor, char *buffer, size_t size);
+void *searchStreamChunks(void *arg);
+void searchStreamSlot(StreamSlot *slot, SearchPattern *pattern);
+bool printStreamSlot(StreamSlot *slot, long *rowAtChunkStart, size_t *columnAtChunkStart);
+long countNewlines(const char *start, const char *end);
+double secondsSince(struct timespec *start);
+void printWorkerTime(int workerNumber, WorkerTime *time);
+int buildTrigramIndex(char *filename);
+char *trigramIndexFilename(char *filename);
+bool openTrigramIndex(char *filename, TrigramIndex *index);
+int searchWithTrigramIndex(char *filename, SearchPattern *pattern);
+const TrigramEntry *findTrigram(const TrigramIndex *index, uint32_t trigram);
+int compareTrigramEntries(const void *first, const void *second);
+size_t intersectPostings(const TrigramIndex *index, const TrigramEntry *entry, uint64_t *candidates,
+                         size_t candidateCount);
+size_t varintLength(uint64_t value);
+size_t encodeVarint(unsigned char *bytes, uint64_t value);
+size_t decodeVarint(const unsigned char *bytes, uint64_t *value);
 
 /**
  * Searches a texfile using child processes.
@@ -31,192 +315,2344 @@ int searchTextWithChildProcess(char **rowsToSearch, int startingRow, int rowCoun
  */
 int main(int argc, char **argv)
 {
+    if (argc == 3 && strcmp(argv[1], "index") == 0) {
+        return buildTrigramIndex(argv[2]);
+    }
+
+    bool searchInPlace = false;
+    bool searchStreaming = false;
+    bool useIndex = false;
+    long processCount = sysconf(_SC_NPROCESSORS_ONLN);
+    char *patternFilename = NULL;
+    char *kernelName = "auto";
+    SearchPattern pattern = { .matchRules = 0 };
+    struct option longOptions[] = {
+            { "count", no_argument, NULL, 'c' },
+            { "exists", no_argument, NULL, 'e' },
+            { "max", required_argument, NULL, 'n' },
+            { NULL, 0, NULL, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "msxtiwj:k:f:", longOptions, NULL)) != -1) {
+        if (option == 'm') {
+            searchInPlace = true;
+        } else if (option == 'i') {
+            pattern.matchRules |= MATCH_FOLDED_CASE;
+        } else if (option == 'w') {
+            pattern.matchRules |= MATCH_WHOLE_WORD;
+        } else if (option == 't') {
+            reportWorkerTimes = true;
+        } else if (option == 'x') {
+            useIndex = true;
+        } else if (option == 's') {
+            searchStreaming = true;
+        } else if (option == 'j') {
+            processCount = atol(optarg);
+            if (processCount < 1) {
+                printf("%s is not a valid amount of processes, exiting..\n", optarg);
+                return 1;
+            }
+        } else if (option == 'k') {
+            kernelName = optarg;
+        } else if (option == 'f') {
+            patternFilename = optarg;
+        } else if (option == 'c') {
+            outputMode = OUTPUT_COUNT;
+        } else if (option == 'e') {
+            outputMode = OUTPUT_EXISTS;
+        } else if (option == 'n') {
+            matchLimit = atol(optarg);
+            if (matchLimit < 1) {
+                printf("%s is not a valid amount of matches, exiting..\n", optarg);
+                return 1;
+            }
+        } else {
+            HELP();
+            return 1;
+        }
+    }
 
-    if (argc != 3 ) {
+    if (argc - optind != (patternFilename != NULL ? 1 : 2)) {
         HELP();
+        return 1;
+    }
+    if (processCount < 1) {
+        processCount = 1;
+    }
+    if (outputMode == OUTPUT_EXISTS) {
+        matchLimit = 1;
+    }
+    if (searchStreaming && (pattern.matchRules & MATCH_WHOLE_WORD)) {
+        printf("Whole word search is not available when streaming, exiting..\n");
+        return 1;
+    }
+    pattern.searchKernel = selectSearchKernel(kernelName, pattern.matchRules);
+    if (pattern.searchKernel == NULL) {
+        printf("%s is not an available search kernel, exiting..\n", kernelName);
+        return 1;
     }
 
-    FILE *filePointer = fopen(argv[1], "r");
-    if (!filePointer) {
+    char *filename = argv[optind];
+    char **patterns = NULL;
+    int patternCount = 0;
+    if (patternFilename != NULL) {
+        if (!loadPatterns(patternFilename, &patterns, &patternCount)) {
+            printf("Error opening pattern file. Exiting..");
+            return 1;
+        }
+        for (int i = 0; i < patternCount && (pattern.matchRules & MATCH_FOLDED_CASE); i++) {
+            foldCaseInPlace(patterns[i]);
+        }
+        pattern.automaton = buildPatternAutomaton(patterns, patternCount, pattern.matchRules);
+        pattern.searchKernel = searchRangeAutomaton;
+    } else {
+        if (pattern.matchRules & MATCH_FOLDED_CASE) {
+            foldCaseInPlace(argv[optind + 1]);
+        }
+        pattern.needle = argv[optind + 1];
+        pattern.needleLength = strlen(pattern.needle);
+        if (pattern.needleLength == 0) {
+            pattern.searchKernel = searchRangeScalar;
+        }
+    }
+
+    int status = -1;
+    if (useIndex && pattern.automaton == NULL && pattern.needleLength >= 3
+            && !(pattern.matchRules & MATCH_FOLDED_CASE)) {
+        status = searchWithTrigramIndex(filename, &pattern);
+        if (status < 0) {
+            fprintf(stderr, "No up to date index of %s, searching the whole file\n", filename);
+        }
+    }
+
+    if (status < 0) {
+        if (searchStreaming) {
+            status = searchStream(filename, &pattern, (int) processCount);
+        } else if (searchInPlace) {
+            status = searchFileInPlace(filename, &pattern, (int) processCount);
+        } else {
+            status = searchFileByRows(filename, &pattern, (int) processCount);
+        }
+    }
+
+    if (outputMode == OUTPUT_COUNT) {
+        printf("%ld\n", matchesFound);
+    } else if (outputMode == OUTPUT_EXISTS) {
+        printf(matchesFound > 0 ? "Found\n" : "Not found\n");
+        if (status == 0 && matchesFound == 0) {
+            status = 1;
+        }
+    }
+
+    if (pattern.automaton != NULL) {
+        freePatternAutomaton(pattern.automaton);
+    }
+    for (int i = 0; i < patternCount; i++) {
+        free(patterns[i]);
+    }
+    free(patterns);
+
+    return status;
+}
+
+/**
+ * Searches a file by loading it into memory, indexing its rows and splitting the rows between the child
+ * processes.
+ *
+ * @param filename The file to search
+ * @param pattern What to search for
+ * @param processCount The amount of search processes
+ * @return Status code
+ */
+int searchFileByRows(char *filename, SearchPattern *pattern, int processCount)
+{
+    IndexedText indexedText;
+    if (!loadTextFile(filename, &indexedText)) {
         printf("Error opening file. Exiting..");
         return 1;
     }
 
-    int rowsCount = countRowsInFile(filePointer);
-    int rowsToAdd = 0;
-    int rowsForEachProcess = 0;
-    bool shouldAddRows = unevenRowCount(rowsCount);
-    calculateRowCounters(&rowsCount, &rowsToAdd, &rowsForEachProcess, shouldAddRows);
+    buildRowIndex(&indexedText);
+    delegateSearchToChildProcesses(processCount, &indexedText, pattern);
+    freeIndexedText(&indexedText);
 
-    fseek(filePointer, 0, SEEK_SET);
-    char **textRows = allocateTextRowsMemory(rowsCount);
-    loadTextRows(filePointer, textRows, shouldAddRows, rowsToAdd);
-    fclose(filePointer);
+    return 0;
+}
+
+/**
+ * Loads a whole file into a single buffer.
+ *
+ * @param filename The file to load
+ * @param indexedText The indexed text to load the file into
+ * @return The file was loaded
+ */
+bool loadTextFile(char *filename, IndexedText *indexedText)
+{
+    FILE *filePointer = fopen(filename, "rb");
+    if (!filePointer) {
+        return false;
+    }
 
-    delegateSearchToChildProcesses(rowsForEachProcess, textRows, argv[2]);
+    fseek(filePointer, 0, SEEK_END);
+    long size = ftell(filePointer);
+    fseek(filePointer, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(filePointer);
+        return false;
+    }
 
-    for (int i = 0; i < rowsCount; i++) {
-        free(textRows[i]);
+    indexedText->size = (size_t) size;
+    indexedText->text = malloc(indexedText->size + 1);
+    if (indexedText->text == NULL) {
+        printf("Error: malloc failed in loadTextFile\n");
+        exit(EXIT_FAILURE);
     }
-    free(textRows);
+    indexedText->size = fread(indexedText->text, 1, indexedText->size, filePointer);
+    fclose(filePointer);
 
-    return 0;
+    return true;
 }
 
 /**
- * Counts the rows in a file.
+ * Indexes the rows of the text in one pass. Each row costs one offset, whatever its length.
  *
- * @param filePointer Pointer to the file
- * @return The rowcount
+ * @param indexedText The indexed text
  */
-int countRowsInFile(FILE *filePointer)
+void buildRowIndex(IndexedText *indexedText)
 {
-    int rowsCount = 1;
-    int character;
-    do {
-        character = fgetc(filePointer);
-        if (character == '\n') {
-            rowsCount++;
+    size_t capacity = 1024;
+    indexedText->rowOffsets = malloc(capacity * sizeof(size_t));
+    if (indexedText->rowOffsets == NULL) {
+        printf("Error: malloc failed in buildRowIndex\n");
+        exit(EXIT_FAILURE);
+    }
+
+    indexedText->rowsCount = 1;
+    indexedText->rowOffsets[0] = 0;
+    const char *textEnd = indexedText->text + indexedText->size;
+    const char *newline = indexedText->text;
+    while ((newline = memchr(newline, '\n', textEnd - newline)) != NULL) {
+        if ((size_t) indexedText->rowsCount == capacity) {
+            capacity *= 2;
+            indexedText->rowOffsets = realloc(indexedText->rowOffsets, capacity * sizeof(size_t));
+            if (indexedText->rowOffsets == NULL) {
+                printf("Error: realloc failed in buildRowIndex\n");
+                exit(EXIT_FAILURE);
+            }
         }
-    } while (character != EOF);
+        newline++;
+        indexedText->rowOffsets[indexedText->rowsCount++] = newline - indexedText->text;
+    }
+}
 
-    return rowsCount;
+/**
+ * Deallocate memory for an indexed text.
+ *
+ * @param indexedText The indexed text
+ */
+void freeIndexedText(IndexedText *indexedText)
+{
+    free(indexedText->text);
+    free(indexedText->rowOffsets);
 }
 
 /**
- * Determines if the rowcount is uneven.
+ * Splits the rows of texts evenly between the search processes, runs them all at once and prints their
+ * results in row order.
  *
- * @param rowsCount The rowcount
- * @return The rowcount is uneven
+ * @param processCount The amount of search processes
+ * @param indexedText The indexed text
+ * @param pattern What to search for
  */
-bool unevenRowCount(int rowsCount)
+void delegateSearchToChildProcesses(int processCount, IndexedText *indexedText, SearchPattern *pattern)
 {
-    if (rowsCount % SEARCH_PROCESSES != 0) {
-        return true;
-    } else {
-        return false;
+    SearchWorker *workers = calloc(processCount, sizeof(SearchWorker));
+    if (workers == NULL) {
+        printf("Error: calloc failed in delegateSearchToChildProcesses\n");
+        exit(EXIT_FAILURE);
     }
+
+    long rowsForEachProcess = indexedText->rowsCount / processCount;
+    long rowsToAdd = indexedText->rowsCount % processCount;
+    long startingRow = 0;
+    for (int processNumber = 0; processNumber < processCount; ++processNumber) {
+        long rowCount = rowsForEachProcess + (processNumber < rowsToAdd ? 1 : 0);
+        searchTextWithChildProcess(&workers[processNumber], indexedText, startingRow, rowCount, pattern);
+        startingRow += rowCount;
+    }
+
+    collectSearchResults(workers, processCount);
+    free(workers);
 }
 
 /**
- * Calculates the rowcount, how many rows to add, and how many rows should be processed by each process.
+ * Search rows of text using a child process, without waiting for it. The rows are contiguous in the text,
+ * so the search kernel runs over all of them at once.
  *
- * @param rowsCount Pointer to the rowcount
- * @param rowsToAdd Pointer to the amount of rows to add
- * @param rowsForEachProcess Pointers to the amount of rows for each process
- * @param shouldAddRows If rows should be added
+ * @param worker The search worker to start
+ * @param indexedText The indexed text
+ * @param firstRow The first row to be searched
+ * @param rowCount The amount of rows to be searched
+ * @param pattern What to search for
+ * @return Status code
  */
-void calculateRowCounters(int *rowsCount, int *rowsToAdd, int *rowsForEachProcess, bool shouldAddRows)
+int searchTextWithChildProcess(SearchWorker *worker, IndexedText *indexedText, long firstRow, long rowCount,
+                               SearchPattern *pattern)
 {
-    if (shouldAddRows) {
-        while (*rowsCount % SEARCH_PROCESSES != 0) {
-            *rowsCount += 1;
-            *rowsToAdd += 1;
+    pid_t pid;
+    pid = startSearchWorker(worker);
+    if (pid < 0) {
+        fprintf(stderr, "Fork Failed");
+        return 1;
+    } else if (pid == 0) { /* child process */
+        ResultWriter writer = { .resultPipe = worker->resultPipe };
+        if (rowCount > 0) {
+            long endRow = firstRow + rowCount;
+            const char *rowsStart = indexedText->text + indexedText->rowOffsets[firstRow];
+            const char *rowsEnd = endRow < indexedText->rowsCount ? indexedText->text + indexedText->rowOffsets[endRow]
+                                                                  : indexedText->text + indexedText->size;
+            pattern->searchKernel(rowsStart, rowsEnd, pattern, &writer);
         }
+        finishResults(&writer, rowCount);
+        exit(0);
+    } else { /* parent process */
+        return 0;
     }
-    *rowsForEachProcess = *rowsCount / SEARCH_PROCESSES;
 }
 
 /**
- * Allocate heap memory for the rows of text in the file.
+ * Searches a file by memory-mapping it once and letting the child processes search their part of the
+ * mapping directly, without copying any rows.
  *
- * @param rowsCount The rowcount
- * @return An allocated array of for text rows
+ * @param filename The file to search
+ * @param pattern What to search for
+ * @param processCount The amount of search processes
+ * @return Status code
  */
-char **allocateTextRowsMemory(int rowsCount)
+int searchFileInPlace(char *filename, SearchPattern *pattern, int processCount)
 {
-    char **textRows = (char **) malloc(rowsCount * sizeof(char *));
-    for (int i = 0; i < rowsCount; i++) {
-        textRows[i] = (char *) malloc(TEXT_BUFFER_SIZE * sizeof(char));
+    MappedFile mappedFile;
+    if (!mapFile(filename, &mappedFile)) {
+        printf("Error opening file. Exiting..");
+        return 1;
     }
 
-    return textRows;
+    delegateRangeSearchToChildProcesses(&mappedFile, pattern, processCount);
+    unmapFile(&mappedFile);
+
+    return 0;
 }
 
 /**
- * Loads all text rows from the file to the allocated array.
+ * Maps a file read-only into memory. An empty file is mapped as an empty range.
  *
- * @param filePointer Pointer to the file
- * @param textRows The allocated array for the text rows
- * @param shouldAddRows If rows should be added
- * @param rowsToAdd Amount of rows to be added
+ * @param filename The file to map
+ * @param mappedFile The mapping to fill in
+ * @return The file was mapped
  */
-void loadTextRows(FILE *filePointer, char **textRows, bool shouldAddRows, int rowsToAdd)
+bool mapFile(char *filename, MappedFile *mappedFile)
 {
-    int row = 0;
-    char textSlice[TEXT_BUFFER_SIZE];
-    while (fgets(textSlice, TEXT_BUFFER_SIZE, filePointer) != NULL) {
-        strcpy(textRows[row], textSlice);
-        row++;
+    int fileDescriptor = open(filename, O_RDONLY);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+
+    struct stat fileStatus;
+    if (fstat(fileDescriptor, &fileStatus) < 0) {
+        close(fileDescriptor);
+        return false;
     }
 
-    if (shouldAddRows) {
-        for (int i = 0; i < rowsToAdd; ++i) {
-            strcpy(textRows[row + i], "");
+    mappedFile->data = NULL;
+    mappedFile->size = (size_t) fileStatus.st_size;
+    if (mappedFile->size > 0) {
+        void *data = mmap(NULL, mappedFile->size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (data == MAP_FAILED) {
+            close(fileDescriptor);
+            return false;
         }
+        madvise(data, mappedFile->size, MADV_SEQUENTIAL);
+        mappedFile->data = data;
     }
+    close(fileDescriptor);
+
+    return true;
 }
 
 /**
- * Splits the rows of texts evenly between the search processes.
+ * Unmaps a file mapped with mapFile.
  *
- * @param rowsForEachProcess The amount of rows for each process
- * @param textRows The rows of text
- * @param searchString The search string
+ * @param mappedFile The mapping
  */
-void delegateSearchToChildProcesses(int rowsForEachProcess, char **textRows, char *searchString)
+void unmapFile(MappedFile *mappedFile)
 {
-    int startingRow = 0;
-    for (int processNumber = 0; processNumber < SEARCH_PROCESSES; ++processNumber) {
-        char **rowsToSearch = (char **) malloc(rowsForEachProcess * sizeof(char *));
-        for (int i = 0; i < rowsForEachProcess; i++) {
-            rowsToSearch[i] = (char *) malloc(TEXT_BUFFER_SIZE * sizeof(char));
-        }
+    if (mappedFile->data != NULL) {
+        munmap((void *) mappedFile->data, mappedFile->size);
+    }
+    mappedFile->data = NULL;
+    mappedFile->size = 0;
+}
 
-        int rowNumber = 0;
-        while (rowNumber < rowsForEachProcess) {
-            strcpy(rowsToSearch[rowNumber], textRows[rowNumber + startingRow]);
-            rowNumber++;
+/**
+ * Splits the mapped file into byte ranges of roughly equal size, one for each search process. Every range
+ * except the first starts right after a newline, so no row is split between two processes.
+ *
+ * @param mappedFile The mapping
+ * @param rangeOffsets The start offset of each range, followed by the end offset of the last range
+ * @param processCount The amount of search processes
+ */
+void splitMappedFile(MappedFile *mappedFile, size_t *rangeOffsets, int processCount)
+{
+    rangeOffsets[0] = 0;
+    for (int range = 1; range < processCount; ++range) {
+        size_t offset = mappedFile->size / processCount * range;
+        if (offset < rangeOffsets[range - 1]) {
+            offset = rangeOffsets[range - 1];
+        } else if (offset > 0) {
+            const char *newline = memchr(mappedFile->data + offset - 1, '\n', mappedFile->size - offset + 1);
+            offset = newline != NULL ? (size_t) (newline - mappedFile->data) + 1 : mappedFile->size;
         }
+        rangeOffsets[range] = offset;
+    }
+    rangeOffsets[processCount] = mappedFile->size;
+}
 
-        searchTextWithChildProcess(rowsToSearch, startingRow, rowsForEachProcess, searchString);
-
-        for (int i = 0; i < rowsForEachProcess; i++) {
-            free(rowsToSearch[i]);
-        }
-        free(rowsToSearch);
+/**
+ * Lets each search process search its own byte range of the mapped file, runs them all at once and prints
+ * their results in row order.
+ *
+ * @param mappedFile The mapping
+ * @param pattern What to search for
+ * @param processCount The amount of search processes
+ */
+void delegateRangeSearchToChildProcesses(MappedFile *mappedFile, SearchPattern *pattern, int processCount)
+{
+    size_t *rangeOffsets = malloc((processCount + 1) * sizeof(size_t));
+    SearchWorker *workers = calloc(processCount, sizeof(SearchWorker));
+    if (rangeOffsets == NULL || workers == NULL) {
+        printf("Error: malloc failed in delegateRangeSearchToChildProcesses\n");
+        exit(EXIT_FAILURE);
+    }
+    splitMappedFile(mappedFile, rangeOffsets, processCount);
 
-        startingRow += rowsForEachProcess;
+    for (int processNumber = 0; processNumber < processCount; ++processNumber) {
+        const char *rangeStart = mappedFile->data + rangeOffsets[processNumber];
+        const char *rangeEnd = mappedFile->data + rangeOffsets[processNumber + 1];
+        searchRangeWithChildProcess(&workers[processNumber], rangeStart, rangeEnd, pattern);
     }
+
+    collectSearchResults(workers, processCount);
+    free(workers);
+    free(rangeOffsets);
 }
 
 /**
- * Search rows of text for the search string using a child process.
+ * Search a byte range of the mapped file using a child process, without waiting for it. The search kernel
+ * runs over the whole range and counts rows and columns while scanning.
  *
- * @param rowsToSearch The rows to be searched
- * @param startingRow  The starting row number
- * @param rowCount The amount of rows to be searched
- * @param searchString The string to search for
+ * @param worker The search worker to start
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
  * @return Status code
  */
-int searchTextWithChildProcess(char **rowsToSearch, int startingRow, int rowCount, char searchString[])
+int searchRangeWithChildProcess(SearchWorker *worker, const char *rangeStart, const char *rangeEnd,
+                                SearchPattern *pattern)
 {
     pid_t pid;
-    pid = fork();
+    pid = startSearchWorker(worker);
     if (pid < 0) {
         fprintf(stderr, "Fork Failed");
         return 1;
     } else if (pid == 0) { /* child process */
-        for (int row = 0; row < rowCount; row++) {
-            char *occurrence = strstr(rowsToSearch[row], searchString);
-            if (occurrence != NULL) {
-                long column = occurrence - rowsToSearch[row];
-                printf("Found in row %d at column %ld: '%s'\n", startingRow + row + 1, column + 1, occurrence);
-            }
-        }
+        ResultWriter writer = { .resultPipe = worker->resultPipe };
+        long rowsSearched = pattern->searchKernel(rangeStart, rangeEnd, pattern, &writer);
+        finishResults(&writer, rowsSearched);
         exit(0);
     } else { /* parent process */
-        wait(NULL);
         return 0;
     }
 }
+
+/**
+ * Selects a search kernel by name, specialized for the matching rules. The auto kernel is the widest vector
+ * kernel the CPU supports.
+ *
+ * @param kernelName auto, avx2, sse2 or scalar
+ * @param matchRules MATCH_FOLDED_CASE and MATCH_WHOLE_WORD flags
+ * @return The search kernel, or NULL if it is unknown or not supported by the CPU
+ */
+SearchKernel selectSearchKernel(char *kernelName, int matchRules)
+{
+    static const SearchKernel scalarKernels[] = {
+            searchRangeScalar, searchRangeFoldedScalar, searchRangeWordScalar, searchRangeFoldedWordScalar
+    };
+    bool automatic = strcmp(kernelName, "auto") == 0;
+#ifdef HAS_X86_KERNELS
+    static const SearchKernel sse2Kernels[] = {
+            searchRangeSse2, searchRangeFoldedSse2, searchRangeWordSse2, searchRangeFoldedWordSse2
+    };
+    static const SearchKernel avx2Kernels[] = {
+            searchRangeAvx2, searchRangeFoldedAvx2, searchRangeWordAvx2, searchRangeFoldedWordAvx2
+    };
+    __builtin_cpu_init();
+    if ((automatic || strcmp(kernelName, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+        return avx2Kernels[matchRules];
+    }
+    if ((automatic || strcmp(kernelName, "sse2") == 0) && __builtin_cpu_supports("sse2")) {
+        return sse2Kernels[matchRules];
+    }
+#endif
+    if (automatic || strcmp(kernelName, "scalar") == 0) {
+        return scalarKernels[matchRules];
+    }
+
+    return NULL;
+}
+
+/**
+ * Folds an ASCII letter to lower case.
+ *
+ * @param byte The byte
+ * @return The folded byte
+ */
+static inline unsigned char foldCase(unsigned char byte)
+{
+    return (unsigned char) (byte - 'A') < 26 ? byte | 0x20 : byte;
+}
+
+/**
+ * Folds the ASCII letters of a string to lower case in place.
+ *
+ * @param text The string
+ */
+void foldCaseInPlace(char *text)
+{
+    for (; *text != '\0'; ++text) {
+        *text = (char) foldCase((unsigned char) *text);
+    }
+}
+
+/**
+ * Compares bytes of the text with a folded needle, ignoring the case of ASCII letters in the text.
+ *
+ * @param text The text
+ * @param foldedNeedle The needle folded to lower case
+ * @param needleLength The length of the needle
+ * @return The bytes match
+ */
+bool foldedEquals(const char *text, const char *foldedNeedle, size_t needleLength)
+{
+    for (size_t i = 0; i < needleLength; ++i) {
+        if (foldCase((unsigned char) text[i]) != (unsigned char) foldedNeedle[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Finds the first occurrence of a folded needle, ignoring the case of ASCII letters in the text. When the
+ * needle starts with a letter, the next upper and lower case occurrence of the letter are both found with
+ * memchr, and only the one that was passed is searched for again.
+ *
+ * @param start Start of the text
+ * @param end End of the text
+ * @param foldedNeedle The needle folded to lower case
+ * @param needleLength The length of the needle
+ * @return The occurrence, or NULL if there is none
+ */
+const char *findFolded(const char *start, const char *end, const char *foldedNeedle, size_t needleLength)
+{
+    if ((size_t) (end - start) < needleLength) {
+        return NULL;
+    }
+    const char *lastStart = end - needleLength + 1;
+    unsigned char lower = (unsigned char) foldedNeedle[0];
+    unsigned char upper = (unsigned char) (lower - 'a') < 26 ? lower & ~0x20 : lower;
+    const char *nextLower = memchr(start, lower, lastStart - start);
+    const char *nextUpper = upper != lower ? memchr(start, upper, lastStart - start) : NULL;
+    while (nextLower != NULL || nextUpper != NULL) {
+        bool lowerFirst = nextUpper == NULL || (nextLower != NULL && nextLower < nextUpper);
+        const char *candidate = lowerFirst ? nextLower : nextUpper;
+        if (foldedEquals(candidate + 1, foldedNeedle + 1, needleLength - 1)) {
+            return candidate;
+        }
+        if (lowerFirst) {
+            nextLower = memchr(candidate + 1, lower, lastStart - candidate - 1);
+        } else {
+            nextUpper = memchr(candidate + 1, upper, lastStart - candidate - 1);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Checks that an occurrence is neither preceded nor followed by a letter, digit or underscore in its row.
+ *
+ * @param rowStart Start of the row of the occurrence
+ * @param rangeEnd End of the searched range
+ * @param occurrence The occurrence
+ * @param length The length of the occurrence
+ * @return The occurrence is a whole word
+ */
+bool isWholeWord(const char *rowStart, const char *rangeEnd, const char *occurrence, size_t length)
+{
+    return (occurrence == rowStart || !isWordByte((unsigned char) occurrence[-1]))
+           && (occurrence + length == rangeEnd || !isWordByte((unsigned char) occurrence[length]));
+}
+
+/**
+ * Checks if a byte is an ASCII letter, digit or underscore.
+ *
+ * @param byte The byte
+ * @return The byte is part of a word
+ */
+bool isWordByte(unsigned char byte)
+{
+    return (unsigned char) (foldCase(byte) - 'a') < 26 || (unsigned char) (byte - '0') < 10 || byte == '_';
+}
+
+/**
+ * Checks if the needle matches at a position under the matching rules of a kernel. Inlined into every
+ * kernel with constant rules, so each kernel only does the checks of its own rules.
+ *
+ * @param state The scan state
+ * @param position The position
+ * @param matchRules MATCH_FOLDED_CASE and MATCH_WHOLE_WORD flags
+ * @return The needle matches
+ */
+static inline __attribute__((always_inline))
+bool matchesNeedle(const ScanState *state, const char *position, int matchRules)
+{
+    if (matchRules & MATCH_FOLDED_CASE) {
+        if (!foldedEquals(position, state->needle, state->needleLength)) {
+            return false;
+        }
+    } else if (memcmp(position, state->needle, state->needleLength) != 0) {
+        return false;
+    }
+
+    return !(matchRules & MATCH_WHOLE_WORD)
+           || isWholeWord(state->rowStart, state->rangeEnd, position, state->needleLength);
+}
+
+/**
+ * Scalar search kernel specialized for the matching rules. Exact search is built on memmem and memchr, and
+ * handles an empty needle as a match at the start of every row.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @param matchRules MATCH_FOLDED_CASE and MATCH_WHOLE_WORD flags
+ * @return The amount of rows in the range
+ */
+static inline __attribute__((always_inline))
+long searchRangeScalarWith(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                           ResultWriter *writer, int matchRules)
+{
+    const char *needle = pattern->needle;
+    size_t needleLength = pattern->needleLength;
+    ScanState state = { needle, needleLength, rangeEnd, 0, rangeStart, writer };
+    const char *position = rangeStart;
+    while (position < rangeEnd) {
+        const char *occurrence;
+        if (needleLength == 0) {
+            occurrence = state.rowStart;
+        } else {
+            occurrence = matchRules & MATCH_FOLDED_CASE ? findFolded(position, rangeEnd, needle, needleLength)
+                                                        : memmem(position, rangeEnd - position, needle, needleLength);
+            if (occurrence == NULL) {
+                break;
+            }
+        }
+
+        const char *newline;
+        while ((newline = memchr(state.rowStart, '\n', occurrence - state.rowStart)) != NULL) {
+            state.row++;
+            state.rowStart = newline + 1;
+        }
+        if (!(matchRules & MATCH_WHOLE_WORD) || isWholeWord(state.rowStart, rangeEnd, occurrence, needleLength)) {
+            reportOccurrence(&state, occurrence);
+        }
+
+        if (needleLength == 0) {
+            const char *rowEnd = memchr(occurrence, '\n', rangeEnd - occurrence);
+            position = rowEnd != NULL ? rowEnd + 1 : rangeEnd;
+            if (rowEnd != NULL) {
+                state.row++;
+                state.rowStart = position;
+            }
+        } else {
+            position = occurrence + 1;
+        }
+    }
+
+    const char *newline;
+    while (state.rowStart < rangeEnd && (newline = memchr(state.rowStart, '\n', rangeEnd - state.rowStart)) != NULL) {
+        state.row++;
+        state.rowStart = newline + 1;
+    }
+
+    return state.row + (state.rowStart < rangeEnd ? 1 : 0);
+}
+
+/**
+ * Exact scalar search kernel.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+long searchRangeScalar(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                       ResultWriter *writer)
+{
+    return searchRangeScalarWith(rangeStart, rangeEnd, pattern, writer, 0);
+}
+
+/**
+ * Scalar search kernel ignoring the case of ASCII letters.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for, folded to lower case
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+long searchRangeFoldedScalar(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                             ResultWriter *writer)
+{
+    return searchRangeScalarWith(rangeStart, rangeEnd, pattern, writer, MATCH_FOLDED_CASE);
+}
+
+/**
+ * Scalar search kernel only reporting whole words.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+long searchRangeWordScalar(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                           ResultWriter *writer)
+{
+    return searchRangeScalarWith(rangeStart, rangeEnd, pattern, writer, MATCH_WHOLE_WORD);
+}
+
+/**
+ * Scalar search kernel ignoring the case of ASCII letters and only reporting whole words.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for, folded to lower case
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+long searchRangeFoldedWordScalar(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                                 ResultWriter *writer)
+{
+    return searchRangeScalarWith(rangeStart, rangeEnd, pattern, writer, MATCH_FOLDED_CASE | MATCH_WHOLE_WORD);
+}
+
+/**
+ * Gets the bit that is set in a block before comparing it with a byte of the needle. Folded kernels set
+ * the case bit of every byte compared with a letter, which folds upper case letters to the lower case of
+ * the needle. Other bytes that happen to fold to the letter are rejected when the whole needle is compared.
+ *
+ * @param needleByte The byte of the needle
+ * @param matchRules MATCH_FOLDED_CASE and MATCH_WHOLE_WORD flags
+ * @return The bit to set
+ */
+static inline __attribute__((always_inline))
+char caseBit(char needleByte, int matchRules)
+{
+    return (matchRules & MATCH_FOLDED_CASE) && (unsigned char) (needleByte - 'a') < 26 ? 0x20 : 0;
+}
+
+/**
+ * Handles the candidate matches and newlines of a block in position order. A candidate is reported if the
+ * whole needle matches, a newline moves the scan to the next row.
+ *
+ * @param state The scan state
+ * @param block Start of the block
+ * @param candidates Bit mask of the positions where the first and last byte of the needle match
+ * @param newlines Bit mask of the newline positions
+ * @param matchRules MATCH_FOLDED_CASE and MATCH_WHOLE_WORD flags
+ */
+static inline __attribute__((always_inline))
+void scanBlockEvents(ScanState *state, const char *block, uint32_t candidates, uint32_t newlines, int matchRules)
+{
+    uint32_t events = candidates | newlines;
+    while (events != 0) {
+        uint32_t event = events & -events;
+        const char *position = block + __builtin_ctz(events);
+        if ((candidates & event) && matchesNeedle(state, position, matchRules)) {
+            reportOccurrence(state, position);
+        }
+        if (newlines & event) {
+            state->row++;
+            state->rowStart = position + 1;
+        }
+        events ^= event;
+    }
+}
+
+/**
+ * Scans the tail of a range that is too short for a vector block one byte at a time, and counts the rows
+ * of the range.
+ *
+ * @param state The scan state
+ * @param position Start of the tail
+ * @param matchRules MATCH_FOLDED_CASE and MATCH_WHOLE_WORD flags
+ * @return The amount of rows in the range
+ */
+static inline __attribute__((always_inline))
+long finishScan(ScanState *state, const char *position, int matchRules)
+{
+    for (; position < state->rangeEnd; ++position) {
+        if ((size_t) (state->rangeEnd - position) >= state->needleLength
+                && matchesNeedle(state, position, matchRules)) {
+            reportOccurrence(state, position);
+        }
+        if (*position == '\n') {
+            state->row++;
+            state->rowStart = position + 1;
+        }
+    }
+
+    return state->row + (state->rowStart < state->rangeEnd ? 1 : 0);
+}
+
+#ifdef HAS_X86_KERNELS
+/**
+ * Search kernel comparing the first and last byte of the needle against 16 positions at a time with SSE2,
+ * and only comparing the whole needle where both match. Specialized for the matching rules.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @param matchRules MATCH_FOLDED_CASE and MATCH_WHOLE_WORD flags
+ * @return The amount of rows in the range
+ */
+static inline __attribute__((always_inline, target("sse2")))
+long searchRangeSse2With(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                         ResultWriter *writer, int matchRules)
+{
+    const char *needle = pattern->needle;
+    size_t needleLength = pattern->needleLength;
+    ScanState state = { needle, needleLength, rangeEnd, 0, rangeStart, writer };
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+    const __m128i firstCase = _mm_set1_epi8(caseBit(needle[0], matchRules));
+    const __m128i lastCase = _mm_set1_epi8(caseBit(needle[needleLength - 1], matchRules));
+    const __m128i newline = _mm_set1_epi8('\n');
+
+    const char *position = rangeStart;
+    while ((size_t) (rangeEnd - position) >= 16 + needleLength - 1) {
+        __m128i blockFirst = _mm_loadu_si128((const __m128i *) position);
+        __m128i blockLast = _mm_loadu_si128((const __m128i *) (position + needleLength - 1));
+        uint32_t newlines = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(blockFirst, newline));
+        if (matchRules & MATCH_FOLDED_CASE) {
+            blockFirst = _mm_or_si128(blockFirst, firstCase);
+            blockLast = _mm_or_si128(blockLast, lastCase);
+        }
+        uint32_t candidates = (uint32_t) _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+        if ((candidates | newlines) != 0) {
+            scanBlockEvents(&state, position, candidates, newlines, matchRules);
+        }
+        position += 16;
+    }
+
+    return finishScan(&state, position, matchRules);
+}
+
+/**
+ * Search kernel comparing the first and last byte of the needle against 32 positions at a time with AVX2,
+ * and only comparing the whole needle where both match. Specialized for the matching rules.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @param matchRules MATCH_FOLDED_CASE and MATCH_WHOLE_WORD flags
+ * @return The amount of rows in the range
+ */
+static inline __attribute__((always_inline, target("avx2")))
+long searchRangeAvx2With(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                         ResultWriter *writer, int matchRules)
+{
+    const char *needle = pattern->needle;
+    size_t needleLength = pattern->needleLength;
+    ScanState state = { needle, needleLength, rangeEnd, 0, rangeStart, writer };
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+    const __m256i firstCase = _mm256_set1_epi8(caseBit(needle[0], matchRules));
+    const __m256i lastCase = _mm256_set1_epi8(caseBit(needle[needleLength - 1], matchRules));
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    const char *position = rangeStart;
+    while ((size_t) (rangeEnd - position) >= 32 + needleLength - 1) {
+        __m256i blockFirst = _mm256_loadu_si256((const __m256i *) position);
+        __m256i blockLast = _mm256_loadu_si256((const __m256i *) (position + needleLength - 1));
+        uint32_t newlines = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(blockFirst, newline));
+        if (matchRules & MATCH_FOLDED_CASE) {
+            blockFirst = _mm256_or_si256(blockFirst, firstCase);
+            blockLast = _mm256_or_si256(blockLast, lastCase);
+        }
+        uint32_t candidates = (uint32_t) _mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last)));
+        if ((candidates | newlines) != 0) {
+            scanBlockEvents(&state, position, candidates, newlines, matchRules);
+        }
+        position += 32;
+    }
+
+    return finishScan(&state, position, matchRules);
+}
+
+/**
+ * Exact SSE2 search kernel.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+__attribute__((target("sse2")))
+long searchRangeSse2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                     ResultWriter *writer)
+{
+    return searchRangeSse2With(rangeStart, rangeEnd, pattern, writer, 0);
+}
+/**
+ * SSE2 search kernel ignoring the case of ASCII letters.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for, folded to lower case
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+__attribute__((target("sse2")))
+long searchRangeFoldedSse2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                           ResultWriter *writer)
+{
+    return searchRangeSse2With(rangeStart, rangeEnd, pattern, writer, MATCH_FOLDED_CASE);
+}
+/**
+ * SSE2 search kernel only reporting whole words.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+__attribute__((target("sse2")))
+long searchRangeWordSse2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                         ResultWriter *writer)
+{
+    return searchRangeSse2With(rangeStart, rangeEnd, pattern, writer, MATCH_WHOLE_WORD);
+}
+/**
+ * SSE2 search kernel ignoring the case of ASCII letters and only reporting whole words.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for, folded to lower case
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+__attribute__((target("sse2")))
+long searchRangeFoldedWordSse2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                               ResultWriter *writer)
+{
+    return searchRangeSse2With(rangeStart, rangeEnd, pattern, writer, MATCH_FOLDED_CASE | MATCH_WHOLE_WORD);
+}
+/**
+ * Exact AVX2 search kernel.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+__attribute__((target("avx2")))
+long searchRangeAvx2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                     ResultWriter *writer)
+{
+    return searchRangeAvx2With(rangeStart, rangeEnd, pattern, writer, 0);
+}
+/**
+ * AVX2 search kernel ignoring the case of ASCII letters.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for, folded to lower case
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+__attribute__((target("avx2")))
+long searchRangeFoldedAvx2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                           ResultWriter *writer)
+{
+    return searchRangeAvx2With(rangeStart, rangeEnd, pattern, writer, MATCH_FOLDED_CASE);
+}
+/**
+ * AVX2 search kernel only reporting whole words.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+__attribute__((target("avx2")))
+long searchRangeWordAvx2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                         ResultWriter *writer)
+{
+    return searchRangeAvx2With(rangeStart, rangeEnd, pattern, writer, MATCH_WHOLE_WORD);
+}
+/**
+ * AVX2 search kernel ignoring the case of ASCII letters and only reporting whole words.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for, folded to lower case
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+__attribute__((target("avx2")))
+long searchRangeFoldedWordAvx2(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                               ResultWriter *writer)
+{
+    return searchRangeAvx2With(rangeStart, rangeEnd, pattern, writer, MATCH_FOLDED_CASE | MATCH_WHOLE_WORD);
+}
+#endif
+
+/**
+ * Reports an occurrence with its row, column and the text from the occurrence to the end of its row.
+ *
+ * @param state The scan state
+ * @param occurrence The occurrence
+ */
+void reportOccurrence(ScanState *state, const char *occurrence)
+{
+    const char *rowEnd = memchr(occurrence, '\n', state->rangeEnd - occurrence);
+    if (rowEnd == NULL) {
+        rowEnd = state->rangeEnd;
+    }
+    reportMatch(state->writer, state->row, occurrence - state->rowStart, occurrence, rowEnd - occurrence);
+}
+
+/**
+ * Search kernel finding every pattern of an Aho-Corasick automaton in a single pass over the range.
+ *
+ * @param rangeStart Start of the range
+ * @param rangeEnd End of the range
+ * @param pattern What to search for
+ * @param writer The result writer of the search process
+ * @return The amount of rows in the range
+ */
+long searchRangeAutomaton(const char *rangeStart, const char *rangeEnd, const SearchPattern *pattern,
+                          ResultWriter *writer)
+{
+    ScanState state = { NULL, 0, rangeEnd, 0, rangeStart, writer };
+    scanWithAutomaton(&state, pattern->automaton, rangeStart, rangeEnd);
+
+    return state.row + (state.rowStart < rangeEnd ? 1 : 0);
+}
+
+/**
+ * Runs the automaton over a byte range and reports each pattern where it ends. Patterns never contain a
+ * newline, so the automaton is back in its start state at the beginning of every row.
+ *
+ * @param state The scan state
+ * @param automaton The automaton
+ * @param start Start of the bytes to scan
+ * @param end End of the bytes to scan
+ */
+void scanWithAutomaton(ScanState *state, const PatternAutomaton *automaton, const char *start, const char *end)
+{
+    const int32_t *transitions = automaton->transitions;
+    const uint16_t *byteClass = automaton->byteClass;
+    int classCount = automaton->classCount;
+
+    int32_t current = 0;
+    for (const char *position = start; position < end; ++position) {
+        unsigned char byte = (unsigned char) *position;
+        current = transitions[current * classCount + byteClass[byte]];
+        bool reporting = state->reportFrom == NULL || position >= state->reportFrom;
+        for (int32_t output = reporting ? automaton->firstOutput[current] : -1; output >= 0;
+             output = automaton->nextOutput[output]) {
+            size_t patternLength = automaton->patternLengths[automaton->patternEnding[output]];
+            const char *occurrence = position + 1 - patternLength;
+            if (!(automaton->matchRules & MATCH_WHOLE_WORD)
+                    || isWholeWord(state->rowStart, state->rangeEnd, occurrence, patternLength)) {
+                reportOccurrence(state, occurrence);
+            }
+        }
+        if (byte == '\n') {
+            state->row++;
+            state->rowStart = position + 1;
+        }
+    }
+}
+
+/**
+ * Loads the patterns of a pattern file, one pattern per line. Empty lines are skipped.
+ *
+ * @param filename The pattern file
+ * @param patterns Pointer to the allocated array of patterns
+ * @param patternCount Pointer to the amount of patterns
+ * @return The pattern file was loaded
+ */
+bool loadPatterns(char *filename, char ***patterns, int *patternCount)
+{
+    FILE *filePointer = fopen(filename, "r");
+    if (!filePointer) {
+        return false;
+    }
+
+    int capacity = 0;
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    ssize_t lineLength;
+    *patterns = NULL;
+    *patternCount = 0;
+    while ((lineLength = getline(&line, &lineCapacity, filePointer)) >= 0) {
+        while (lineLength > 0 && (line[lineLength - 1] == '\n' || line[lineLength - 1] == '\r')) {
+            line[--lineLength] = '\0';
+        }
+        if (lineLength == 0) {
+            continue;
+        }
+
+        if (*patternCount == capacity) {
+            capacity = capacity == 0 ? 16 : capacity * 2;
+            *patterns = realloc(*patterns, capacity * sizeof(char *));
+            if (*patterns == NULL) {
+                printf("Error: realloc failed in loadPatterns\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        (*patterns)[(*patternCount)++] = strdup(line);
+    }
+    free(line);
+    fclose(filePointer);
+
+    return true;
+}
+
+/**
+ * Builds an Aho-Corasick automaton over the patterns. The trie of the patterns is completed into a full
+ * transition table in breadth-first order, so scanning takes exactly one table lookup per byte.
+ *
+ * @param patterns The patterns, folded to lower case when the matching rules fold case
+ * @param patternCount The amount of patterns
+ * @param matchRules MATCH_FOLDED_CASE and MATCH_WHOLE_WORD flags
+ * @return The automaton
+ */
+PatternAutomaton *buildPatternAutomaton(char **patterns, int patternCount, int matchRules)
+{
+    PatternAutomaton *automaton = calloc(1, sizeof(PatternAutomaton));
+    if (automaton == NULL) {
+        printf("Error: calloc failed in buildPatternAutomaton\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t maxStates = 1;
+    bool byteUsed[256] = { false };
+    for (int i = 0; i < patternCount; ++i) {
+        for (const unsigned char *byte = (const unsigned char *) patterns[i]; *byte != '\0'; ++byte) {
+            byteUsed[*byte] = true;
+            maxStates++;
+        }
+    }
+    automaton->classCount = 1;
+    for (int byte = 0; byte < 256; ++byte) {
+        automaton->byteClass[byte] = byteUsed[byte] ? automaton->classCount++ : 0;
+    }
+    if (matchRules & MATCH_FOLDED_CASE) {
+        for (int byte = 'A'; byte <= 'Z'; ++byte) {
+            automaton->byteClass[byte] = automaton->byteClass[byte | 0x20];
+        }
+    }
+    automaton->matchRules = matchRules;
+
+    int classCount = automaton->classCount;
+    automaton->transitions = malloc(maxStates * classCount * sizeof(int32_t));
+    automaton->patternEnding = malloc(maxStates * sizeof(int32_t));
+    automaton->firstOutput = malloc(maxStates * sizeof(int32_t));
+    automaton->nextOutput = malloc(maxStates * sizeof(int32_t));
+    automaton->patternLengths = malloc((patternCount + 1) * sizeof(size_t));
+    automaton->longestPattern = 0;
+    int32_t *failure = malloc(maxStates * sizeof(int32_t));
+    int32_t *queue = malloc(maxStates * sizeof(int32_t));
+    if (automaton->transitions == NULL || automaton->patternEnding == NULL || automaton->firstOutput == NULL
+            || automaton->nextOutput == NULL || automaton->patternLengths == NULL || failure == NULL
+            || queue == NULL) {
+        printf("Error: malloc failed in buildPatternAutomaton\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(automaton->transitions, -1, maxStates * classCount * sizeof(int32_t));
+    memset(automaton->patternEnding, -1, maxStates * sizeof(int32_t));
+
+    int32_t *transitions = automaton->transitions;
+    automaton->stateCount = 1;
+    automaton->patternCount = patternCount;
+    for (int i = 0; i < patternCount; ++i) {
+        automaton->patternLengths[i] = strlen(patterns[i]);
+        if (automaton->patternLengths[i] > automaton->longestPattern) {
+            automaton->longestPattern = automaton->patternLengths[i];
+        }
+        int32_t current = 0;
+        for (const unsigned char *byte = (const unsigned char *) patterns[i]; *byte != '\0'; ++byte) {
+            int32_t *next = &transitions[current * classCount + automaton->byteClass[*byte]];
+            if (*next < 0) {
+                *next = automaton->stateCount++;
+            }
+            current = *next;
+        }
+        automaton->patternEnding[current] = i;
+    }
+
+    int queueStart = 0;
+    int queueEnd = 0;
+    failure[0] = 0;
+    automaton->firstOutput[0] = -1;
+    automaton->nextOutput[0] = -1;
+    queue[queueEnd++] = 0;
+    while (queueStart < queueEnd) {
+        int32_t current = queue[queueStart++];
+        for (int byteClass = 0; byteClass < classCount; ++byteClass) {
+            int32_t *next = &transitions[current * classCount + byteClass];
+            int32_t fallback = current == 0 ? 0 : transitions[failure[current] * classCount + byteClass];
+            if (*next < 0) {
+                *next = fallback;
+                continue;
+            }
+
+            int32_t child = *next;
+            failure[child] = fallback;
+            automaton->nextOutput[child] = automaton->firstOutput[fallback];
+            automaton->firstOutput[child] = automaton->patternEnding[child] >= 0 ? child
+                                                                                 : automaton->firstOutput[fallback];
+            queue[queueEnd++] = child;
+        }
+    }
+
+    free(failure);
+    free(queue);
+
+    return automaton;
+}
+
+/**
+ * Deallocate memory for an automaton.
+ *
+ * @param automaton The automaton
+ */
+void freePatternAutomaton(PatternAutomaton *automaton)
+{
+    free(automaton->transitions);
+    free(automaton->patternEnding);
+    free(automaton->firstOutput);
+    free(automaton->nextOutput);
+    free(automaton->patternLengths);
+    free(automaton);
+}
+
+/**
+ * Forks a search worker connected to the parent by a result pipe. In the child the worker keeps the write
+ * end of the pipe, in the parent it keeps the read end.
+ *
+ * @param worker The search worker
+ * @return The pid of the child in the parent, 0 in the child, or -1 on failure
+ */
+pid_t startSearchWorker(SearchWorker *worker)
+{
+    int resultPipe[2];
+    if (pipe(resultPipe) < 0) {
+        return -1;
+    }
+
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &worker->startTime);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(resultPipe[0]);
+        close(resultPipe[1]);
+        worker->finished = true;
+        return -1;
+    } else if (pid == 0) {
+        close(resultPipe[0]);
+        worker->resultPipe = resultPipe[1];
+    } else {
+        close(resultPipe[1]);
+        worker->resultPipe = resultPipe[0];
+        worker->pid = pid;
+    }
+
+    return pid;
+}
+
+/**
+ * Reports a match to the parent. Matches are sent in batches, and only counted when only the amount of
+ * matches is printed. A search process stops as soon as it has found as many matches as the limit, since
+ * the parent never needs more than that from a single process. A search thread stops keeping matches.
+ *
+ * @param writer The result writer of the search process
+ * @param row The row relative to the first row of the process
+ * @param column The column in the row
+ * @param text The text from the match to the end of the row
+ * @param textLength The length of the text
+ */
+void reportMatch(ResultWriter *writer, long row, long column, const char *text, size_t textLength)
+{
+    if (writer->matchesFound >= matchLimit) {
+        return;
+    }
+    writer->matchesFound++;
+
+    if (outputMode == OUTPUT_MATCHES) {
+        SearchMatch *match = &writer->matches[writer->matchCount++];
+        match->row = row;
+        match->column = column;
+        match->text = text;
+        match->textLength = textLength;
+
+        if (writer->matchCount == RESULT_BATCH_SIZE) {
+            flushResults(writer);
+        }
+    }
+
+    if (writer->matchesFound == matchLimit && writer->collectedMatches == NULL) {
+        finishResults(writer, -1);
+        exit(0);
+    }
+}
+
+/**
+ * Sends the remaining matches, the amount of searched rows and the amount of found matches to the parent,
+ * then closes the pipe.
+ *
+ * @param writer The result writer of the search process
+ * @param rowsSearched The amount of rows the process searched, or -1 if it stopped early
+ */
+void finishResults(ResultWriter *writer, long rowsSearched)
+{
+    SearchMatch *last = &writer->matches[writer->matchCount++];
+    last->row = rowsSearched;
+    last->column = writer->matchesFound;
+    last->text = NULL;
+    last->textLength = 0;
+
+    flushResults(writer);
+    close(writer->resultPipe);
+}
+
+/**
+ * Writes the batched matches to the result pipe, or adds them to the collected matches.
+ *
+ * @param writer The result writer of the search process
+ */
+void flushResults(ResultWriter *writer)
+{
+    if (writer->collectedMatches != NULL) {
+        for (int i = 0; i < writer->matchCount; ++i) {
+            appendMatch(writer->collectedMatches, &writer->matches[i]);
+        }
+        writer->matchCount = 0;
+        return;
+    }
+
+    const char *bytes = (const char *) writer->matches;
+    size_t remaining = writer->matchCount * sizeof(SearchMatch);
+    while (remaining > 0) {
+        ssize_t written = write(writer->resultPipe, bytes, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            exit(1);
+        }
+        bytes += written;
+        remaining -= written;
+    }
+    writer->matchCount = 0;
+}
+
+/**
+ * Reads the results of all search processes as they arrive and prints them in row order. The matches of
+ * the earliest unfinished process are printed right away, the matches of later processes are held back
+ * until every process before them has finished. Each process is reaped once its pipe is closed. When
+ * only the amount of matches is printed, the amount of each process is added as soon as it finishes. The
+ * remaining processes are cancelled once the match limit is reached.
+ *
+ * @param workers The search workers
+ * @param processCount The amount of search processes
+ */
+void collectSearchResults(SearchWorker *workers, int processCount)
+{
+    struct pollfd *pollDescriptors = malloc(processCount * sizeof(struct pollfd));
+    if (pollDescriptors == NULL) {
+        printf("Error: malloc failed in collectSearchResults\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int currentWorker = 0;
+    long startingRow = 0;
+    bool searching = true;
+    while (searching && currentWorker < processCount) {
+        SearchWorker *current = &workers[currentWorker];
+        for (size_t i = 0; i < current->pendingMatches.count && searching; ++i) {
+            searching = emitMatch(&current->pendingMatches.matches[i], startingRow);
+        }
+        current->pendingMatches.count = 0;
+
+        if (current->finished && searching) {
+            startingRow += current->rowsSearched;
+            currentWorker++;
+            continue;
+        }
+        if (!searching) {
+            break;
+        }
+
+        int descriptorCount = 0;
+        for (int i = currentWorker; i < processCount; ++i) {
+            if (!workers[i].finished) {
+                pollDescriptors[descriptorCount].fd = workers[i].resultPipe;
+                pollDescriptors[descriptorCount].events = POLLIN;
+                descriptorCount++;
+            }
+        }
+        if (poll(pollDescriptors, descriptorCount, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = currentWorker, j = 0; i < processCount; ++i) {
+            if (!workers[i].finished) {
+                if (pollDescriptors[j].revents != 0) {
+                    readSearchResults(&workers[i]);
+                    if (workers[i].finished && outputMode != OUTPUT_MATCHES) {
+                        searching = addMatchCount(workers[i].matchesCounted) && searching;
+                    }
+                }
+                j++;
+            }
+        }
+    }
+
+    free(pollDescriptors);
+    cancelSearchWorkers(workers, processCount);
+
+    if (reportWorkerTimes) {
+        for (int i = 0; i < processCount; ++i) {
+            printWorkerTime(i, &workers[i].time);
+        }
+    }
+}
+
+/**
+ * Reads the available results of a search process into its pending matches. When the pipe is closed the
+ * process is reaped and marked as finished.
+ *
+ * @param worker The search worker
+ */
+void readSearchResults(SearchWorker *worker)
+{
+    char buffer[RESULT_BATCH_SIZE * sizeof(SearchMatch)];
+    memcpy(buffer, worker->partialRecord, worker->partialLength);
+    ssize_t bytesRead = read(worker->resultPipe, buffer + worker->partialLength,
+                             sizeof(buffer) - worker->partialLength);
+    if (bytesRead < 0 && errno == EINTR) {
+        return;
+    }
+
+    if (bytesRead <= 0) {
+        close(worker->resultPipe);
+        int status;
+        struct rusage usage;
+        wait4(worker->pid, &status, 0, &usage);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "Search process %d failed\n", worker->pid);
+        }
+        worker->time.wallSeconds = secondsSince(&worker->startTime);
+        worker->time.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+                                  + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+        worker->finished = true;
+        return;
+    }
+
+    size_t available = worker->partialLength + bytesRead;
+    size_t offset = 0;
+    while (available - offset >= sizeof(SearchMatch)) {
+        SearchMatch match;
+        memcpy(&match, buffer + offset, sizeof(SearchMatch));
+        if (match.text == NULL) {
+            worker->rowsSearched = match.row;
+            worker->matchesCounted = match.column;
+        } else {
+            appendMatch(&worker->pendingMatches, &match);
+        }
+        offset += sizeof(SearchMatch);
+    }
+    worker->partialLength = available - offset;
+    memcpy(worker->partialRecord, buffer + offset, worker->partialLength);
+}
+
+/**
+ * Stops and reaps every unfinished search process, and frees the pending matches of all processes.
+ *
+ * @param workers The search workers
+ * @param processCount The amount of search processes
+ */
+void cancelSearchWorkers(SearchWorker *workers, int processCount)
+{
+    for (int i = 0; i < processCount; ++i) {
+        if (!workers[i].finished) {
+            kill(workers[i].pid, SIGKILL);
+            close(workers[i].resultPipe);
+            waitpid(workers[i].pid, NULL, 0);
+            workers[i].finished = true;
+        }
+        free(workers[i].pendingMatches.matches);
+        workers[i].pendingMatches.matches = NULL;
+    }
+}
+
+/**
+ * Adds a match to a match list.
+ *
+ * @param matchList The match list
+ * @param match The match
+ */
+void appendMatch(MatchList *matchList, SearchMatch *match)
+{
+    if (matchList->count == matchList->capacity) {
+        matchList->capacity = matchList->capacity == 0 ? RESULT_BATCH_SIZE : matchList->capacity * 2;
+        matchList->matches = realloc(matchList->matches, matchList->capacity * sizeof(SearchMatch));
+        if (matchList->matches == NULL) {
+            printf("Error: realloc failed in appendMatch\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    matchList->matches[matchList->count++] = *match;
+}
+
+/**
+ * Prints a match unless only the amount of matches is printed, and counts it.
+ *
+ * @param match The match
+ * @param startingRow The row number the search process started at
+ * @return The match limit is not reached yet
+ */
+bool emitMatch(SearchMatch *match, long startingRow)
+{
+    if (outputMode == OUTPUT_MATCHES) {
+        printMatch(match, startingRow);
+    }
+
+    return addMatchCount(1);
+}
+
+/**
+ * Adds to the amount of found matches, up to the match limit.
+ *
+ * @param count The amount to add
+ * @return The match limit is not reached yet
+ */
+bool addMatchCount(long count)
+{
+    matchesFound += count < matchLimit - matchesFound ? count : matchLimit - matchesFound;
+
+    return matchesFound < matchLimit;
+}
+
+/**
+ * Prints a match.
+ *
+ * @param match The match
+ * @param startingRow The row number the search process started at
+ */
+void printMatch(SearchMatch *match, long startingRow)
+{
+    printf("Found in row %ld at column %ld: '%.*s'\n",
+           startingRow + match->row + 1, match->column + 1, (int) match->textLength, match->text);
+}
+
+/**
+ * Searches a file or stdin as a stream. The reading thread reads fixed-size chunks into a ring buffer and
+ * a bounded pool of search threads searches them. The results of each chunk are printed in order before
+ * its slot is reused, so the memory use does not depend on the size of the input.
+ *
+ * @param filename The file to search, or - for stdin
+ * @param pattern What to search for
+ * @param threadCount The amount of search threads
+ * @return Status code
+ */
+int searchStream(char *filename, SearchPattern *pattern, int threadCount)
+{
+    size_t longestPattern = longestPatternLength(pattern);
+    if (longestPattern == 0) {
+        printf("The search string can not be empty when streaming. Exiting..");
+        return 1;
+    }
+
+    int fileDescriptor = strcmp(filename, "-") == 0 ? STDIN_FILENO : open(filename, O_RDONLY);
+    if (fileDescriptor < 0) {
+        printf("Error opening file. Exiting..");
+        return 1;
+    }
+
+    StreamRing ring = {
+            .slotCount = threadCount * STREAM_SLOTS_PER_WORKER,
+            .pattern = pattern,
+            .claimLock = PTHREAD_MUTEX_INITIALIZER
+    };
+    size_t overlap = longestPattern - 1;
+    ring.slots = calloc(ring.slotCount, sizeof(StreamSlot));
+    pthread_t *threads = malloc(threadCount * sizeof(pthread_t));
+    if (ring.slots == NULL || threads == NULL) {
+        printf("Error: malloc failed in searchStream\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < ring.slotCount; ++i) {
+        ring.slots[i].data = malloc(overlap + STREAM_CHUNK_SIZE);
+        if (ring.slots[i].data == NULL) {
+            printf("Error: malloc failed in searchStream\n");
+            exit(EXIT_FAILURE);
+        }
+        sem_init(&ring.slots[i].searched, 0, 0);
+    }
+    sem_init(&ring.filledSlots, 0, 0);
+
+    for (int i = 0; i < threadCount; ++i) {
+        if (pthread_create(&threads[i], NULL, searchStreamChunks, &ring) != 0) {
+            perror("Thread creation failed");
+            exit(1);
+        }
+    }
+
+    int status = 0;
+    long chunk = 0;
+    long rowAtChunkStart = 0;
+    size_t columnAtChunkStart = 0;
+    bool searching = true;
+    while (true) {
+        StreamSlot *slot = &ring.slots[chunk % ring.slotCount];
+        if (chunk >= ring.slotCount) {
+            sem_wait(&slot->searched);
+            searching = printStreamSlot(slot, &rowAtChunkStart, &columnAtChunkStart);
+            if (!searching) {
+                break;
+            }
+        }
+
+        slot->carryLength = 0;
+        if (chunk > 0) {
+            StreamSlot *previous = &ring.slots[(chunk - 1) % ring.slotCount];
+            slot->carryLength = previous->length < overlap ? previous->length : overlap;
+            memcpy(slot->data, previous->data + previous->length - slot->carryLength, slot->carryLength);
+        }
+
+        ssize_t bytesRead = readChunk(fileDescriptor, slot->data + slot->carryLength, STREAM_CHUNK_SIZE);
+        if (bytesRead <= 0) {
+            if (bytesRead < 0) {
+                perror("read");
+                status = 1;
+            }
+            break;
+        }
+        slot->length = slot->carryLength + bytesRead;
+
+        chunk++;
+        sem_post(&ring.filledSlots);
+    }
+
+    pthread_mutex_lock(&ring.claimLock);
+    ring.chunkCount = chunk;
+    ring.readingFinished = true;
+    ring.cancelled = !searching;
+    pthread_mutex_unlock(&ring.claimLock);
+    for (int i = 0; i < threadCount; ++i) {
+        sem_post(&ring.filledSlots);
+    }
+
+    long firstUnprinted = chunk >= ring.slotCount ? chunk - ring.slotCount + 1 : 0;
+    for (long remaining = firstUnprinted; remaining < chunk; ++remaining) {
+        StreamSlot *slot = &ring.slots[remaining % ring.slotCount];
+        sem_wait(&slot->searched);
+        if (searching) {
+            searching = printStreamSlot(slot, &rowAtChunkStart, &columnAtChunkStart);
+            if (!searching) {
+                pthread_mutex_lock(&ring.claimLock);
+                ring.cancelled = true;
+                pthread_mutex_unlock(&ring.claimLock);
+            }
+        }
+    }
+
+    for (int i = 0; i < threadCount; ++i) {
+        void *result;
+        pthread_join(threads[i], &result);
+        if (result != NULL) {
+            if (reportWorkerTimes) {
+                printWorkerTime(i, (WorkerTime *) result);
+            }
+            free(result);
+        }
+    }
+    for (int i = 0; i < ring.slotCount; ++i) {
+        free(ring.slots[i].data);
+        free(ring.slots[i].matches.matches);
+        sem_destroy(&ring.slots[i].searched);
+    }
+    sem_destroy(&ring.filledSlots);
+    pthread_mutex_destroy(&ring.claimLock);
+    free(ring.slots);
+    free(threads);
+    if (fileDescriptor != STDIN_FILENO) {
+        close(fileDescriptor);
+    }
+
+    return status;
+}
+
+/**
+ * Gets the length of the longest string searched for.
+ *
+ * @param pattern What to search for
+ * @return The length of the longest string
+ */
+size_t longestPatternLength(SearchPattern *pattern)
+{
+    return pattern->automaton != NULL ? pattern->automaton->longestPattern : pattern->needleLength;
+}
+
+/**
+ * Reads until the buffer is full or the input ends.
+ *
+ * @param fileDescriptor The input
+ * @param buffer The buffer
+ * @param size The size of the buffer
+ * @return The amount of bytes read, or -1 on failure
+ */
+ssize_t readChunk(int fileDescriptor, char *buffer, size_t size)
+{
+    size_t total = 0;
+    while (total < size) {
+        ssize_t bytesRead = read(fileDescriptor, buffer + total, size - total);
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        } else if (bytesRead == 0) {
+            break;
+        }
+        total += bytesRead;
+    }
+
+    return (ssize_t) total;
+}
+
+/**
+ * Search thread of the stream. Claims filled slots in chunk order and searches them until the reading
+ * thread has read the last chunk. Slots claimed after the stream is cancelled are skipped.
+ *
+ * @param arg The stream ring buffer
+ * @return The allocated time of the thread
+ */
+void *searchStreamChunks(void *arg)
+{
+    StreamRing *ring = (StreamRing *) arg;
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    while (true) {
+        sem_wait(&ring->filledSlots);
+        pthread_mutex_lock(&ring->claimLock);
+        long chunk = ring->nextChunk++;
+        bool finished = ring->readingFinished && chunk >= ring->chunkCount;
+        bool cancelled = ring->cancelled;
+        pthread_mutex_unlock(&ring->claimLock);
+        if (finished) {
+            break;
+        }
+
+        StreamSlot *slot = &ring->slots[chunk % ring->slotCount];
+        if (!cancelled) {
+            searchStreamSlot(slot, ring->pattern);
+        }
+        sem_post(&slot->searched);
+    }
+
+    WorkerTime *time = malloc(sizeof(WorkerTime));
+    if (time != NULL) {
+        struct timespec cpuTime;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime);
+        time->wallSeconds = secondsSince(&startTime);
+        time->cpuSeconds = cpuTime.tv_sec + cpuTime.tv_nsec / 1e9;
+    }
+
+    return time;
+}
+
+/**
+ * Searches a slot and counts its newlines. Rows of the matches are counted from the start of the slot data
+ * and their columns from the start of the slot data when no newline comes before them.
+ *
+ * @param slot The slot
+ * @param pattern What to search for
+ */
+void searchStreamSlot(StreamSlot *slot, SearchPattern *pattern)
+{
+    const char *chunkStart = slot->data + slot->carryLength;
+    const char *chunkEnd = slot->data + slot->length;
+    slot->carryNewlines = countNewlines(slot->data, chunkStart);
+    slot->chunkNewlines = countNewlines(chunkStart, chunkEnd);
+    if (slot->chunkNewlines > 0) {
+        const char *lastNewline = memrchr(chunkStart, '\n', chunkEnd - chunkStart);
+        slot->bytesAfterLastNewline = chunkEnd - lastNewline - 1;
+    }
+
+    ResultWriter writer = { .resultPipe = -1, .collectedMatches = &slot->matches };
+    if (pattern->automaton != NULL) {
+        ScanState state = { NULL, 0, chunkEnd, 0, slot->data, &writer, chunkStart };
+        scanWithAutomaton(&state, pattern->automaton, slot->data, chunkEnd);
+    } else {
+        pattern->searchKernel(slot->data, chunkEnd, pattern, &writer);
+    }
+    flushResults(&writer);
+    slot->matchCount = writer.matchesFound;
+}
+
+/**
+ * Prints the matches of a searched slot, or adds their amount, and moves the row and column counters to
+ * the start of the next chunk. The slot can be reused afterwards.
+ *
+ * @param slot The slot
+ * @param rowAtChunkStart Pointer to the row the chunk of the slot starts in
+ * @param columnAtChunkStart Pointer to the column the chunk of the slot starts at
+ * @return The match limit is not reached yet
+ */
+bool printStreamSlot(StreamSlot *slot, long *rowAtChunkStart, size_t *columnAtChunkStart)
+{
+    bool searching = true;
+    if (outputMode != OUTPUT_MATCHES) {
+        searching = addMatchCount(slot->matchCount);
+    }
+    for (size_t i = 0; i < slot->matches.count && searching; ++i) {
+        SearchMatch match = slot->matches.matches[i];
+        if (match.row == 0) {
+            match.column += (long) *columnAtChunkStart - (long) slot->carryLength;
+        }
+        searching = emitMatch(&match, *rowAtChunkStart - slot->carryNewlines);
+    }
+    slot->matches.count = 0;
+
+    *rowAtChunkStart += slot->chunkNewlines;
+    if (slot->chunkNewlines > 0) {
+        *columnAtChunkStart = slot->bytesAfterLastNewline;
+    } else {
+        *columnAtChunkStart += slot->length - slot->carryLength;
+    }
+
+    return searching;
+}
+
+/**
+ * Counts the newlines in a byte range.
+ *
+ * @param start Start of the range
+ * @param end End of the range
+ * @return The amount of newlines
+ */
+long countNewlines(const char *start, const char *end)
+{
+    long newlines = 0;
+    const char *newline;
+    while (start < end && (newline = memchr(start, '\n', end - start)) != NULL) {
+        newlines++;
+        start = newline + 1;
+    }
+
+    return newlines;
+}
+
+/**
+ * Builds a trigram index of a file and stores it next to the file. Each trigram within a row gets a
+ * posting list of the rows it occurs in. The first pass counts the size of each posting list and the second
+ * writes the lists to their place in a single buffer.
+ *
+ * @param filename The file to index
+ * @return Status code
+ */
+int buildTrigramIndex(char *filename)
+{
+    MappedFile source;
+    struct stat sourceStatus;
+    if (stat(filename, &sourceStatus) < 0 || !mapFile(filename, &source)) {
+        printf("Error opening file. Exiting..");
+        return 1;
+    }
+
+    uint32_t *lastRow = calloc(TRIGRAM_COUNT, sizeof(uint32_t));
+    uint32_t *rowCounts = calloc(TRIGRAM_COUNT, sizeof(uint32_t));
+    uint64_t *postingCursors = calloc(TRIGRAM_COUNT, sizeof(uint64_t));
+    size_t rowCapacity = 1024;
+    uint64_t *rowOffsets = malloc(rowCapacity * sizeof(uint64_t));
+    if (lastRow == NULL || rowCounts == NULL || postingCursors == NULL || rowOffsets == NULL) {
+        printf("Error: malloc failed in buildTrigramIndex\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const unsigned char *data = (const unsigned char *) source.data;
+    uint64_t rowsCount = 1;
+    rowOffsets[0] = 0;
+    uint32_t row = 0;
+    uint32_t trigram = 0;
+    int rowBytes = 0;
+    for (size_t i = 0; i < source.size; ++i) {
+        if (data[i] == '\n') {
+            if (row == UINT32_MAX - 1) {
+                printf("The file has too many rows to be indexed. Exiting..");
+                return 1;
+            }
+            if (rowsCount == rowCapacity) {
+                rowCapacity *= 2;
+                rowOffsets = realloc(rowOffsets, rowCapacity * sizeof(uint64_t));
+                if (rowOffsets == NULL) {
+                    printf("Error: realloc failed in buildTrigramIndex\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            rowOffsets[rowsCount++] = i + 1;
+            row++;
+            rowBytes = 0;
+            continue;
+        }
+
+        trigram = ((trigram << 8) | data[i]) & (TRIGRAM_COUNT - 1);
+        if (++rowBytes >= 3 && lastRow[trigram] != row + 1) {
+            uint32_t previousRow = lastRow[trigram] == 0 ? 0 : lastRow[trigram] - 1;
+            postingCursors[trigram] += varintLength(row - previousRow);
+            rowCounts[trigram]++;
+            lastRow[trigram] = row + 1;
+        }
+    }
+
+    uint64_t trigramCount = 0;
+    uint64_t postingsSize = 0;
+    for (uint32_t i = 0; i < TRIGRAM_COUNT; ++i) {
+        if (rowCounts[i] > 0) {
+            trigramCount++;
+        }
+        uint64_t listSize = postingCursors[i];
+        postingCursors[i] = postingsSize;
+        postingsSize += listSize;
+    }
+
+    TrigramEntry *entries = malloc((trigramCount + 1) * sizeof(TrigramEntry));
+    unsigned char *postings = malloc(postingsSize + 1);
+    if (entries == NULL || postings == NULL) {
+        printf("Error: malloc failed in buildTrigramIndex\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0, entry = 0; i < TRIGRAM_COUNT; ++i) {
+        if (rowCounts[i] > 0) {
+            entries[entry].trigram = i;
+            entries[entry].rowCount = rowCounts[i];
+            entries[entry].postingOffset = postingCursors[i];
+            entry++;
+        }
+    }
+
+    memset(lastRow, 0, TRIGRAM_COUNT * sizeof(uint32_t));
+    row = 0;
+    rowBytes = 0;
+    for (size_t i = 0; i < source.size; ++i) {
+        if (data[i] == '\n') {
+            row++;
+            rowBytes = 0;
+            continue;
+        }
+
+        trigram = ((trigram << 8) | data[i]) & (TRIGRAM_COUNT - 1);
+        if (++rowBytes >= 3 && lastRow[trigram] != row + 1) {
+            uint32_t previousRow = lastRow[trigram] == 0 ? 0 : lastRow[trigram] - 1;
+            postingCursors[trigram] += encodeVarint(postings + postingCursors[trigram], row - previousRow);
+            lastRow[trigram] = row + 1;
+        }
+    }
+
+    TrigramIndexHeader header = {
+            .sourceSize = (uint64_t) sourceStatus.st_size,
+            .sourceModifiedSeconds = sourceStatus.st_mtim.tv_sec,
+            .sourceModifiedNanoseconds = sourceStatus.st_mtim.tv_nsec,
+            .rowsCount = rowsCount,
+            .trigramCount = trigramCount,
+            .postingsSize = postingsSize
+    };
+    memcpy(header.magic, TRIGRAM_INDEX_MAGIC, sizeof(header.magic));
+
+    char *indexFilename = trigramIndexFilename(filename);
+    char *temporaryFilename = malloc(strlen(indexFilename) + 5);
+    if (temporaryFilename == NULL) {
+        printf("Error: malloc failed in buildTrigramIndex\n");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(temporaryFilename, "%s.tmp", indexFilename);
+
+    int status = 0;
+    FILE *indexFile = fopen(temporaryFilename, "wb");
+    if (indexFile == NULL
+            || fwrite(&header, sizeof(header), 1, indexFile) != 1
+            || fwrite(rowOffsets, sizeof(uint64_t), rowsCount, indexFile) != rowsCount
+            || fwrite(entries, sizeof(TrigramEntry), trigramCount, indexFile) != trigramCount
+            || fwrite(postings, 1, postingsSize, indexFile) != postingsSize
+            || fclose(indexFile) != 0
+            || rename(temporaryFilename, indexFilename) != 0) {
+        printf("Error writing index %s. Exiting..", indexFilename);
+        unlink(temporaryFilename);
+        status = 1;
+    } else {
+        printf("Indexed %llu rows and %llu trigrams of %s into %s\n", (unsigned long long) rowsCount,
+               (unsigned long long) trigramCount, filename, indexFilename);
+    }
+
+    free(temporaryFilename);
+    free(indexFilename);
+    free(postings);
+    free(entries);
+    free(rowOffsets);
+    free(postingCursors);
+    free(rowCounts);
+    free(lastRow);
+    unmapFile(&source);
+
+    return status;
+}
+
+/**
+ * Gets the filename of the trigram index of a file.
+ *
+ * @param filename The indexed file
+ * @return The allocated filename of the index
+ */
+char *trigramIndexFilename(char *filename)
+{
+    char *indexFilename = malloc(strlen(filename) + strlen(TRIGRAM_INDEX_SUFFIX) + 1);
+    if (indexFilename == NULL) {
+        printf("Error: malloc failed in trigramIndexFilename\n");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(indexFilename, "%s%s", filename, TRIGRAM_INDEX_SUFFIX);
+
+    return indexFilename;
+}
+
+/**
+ * Maps the trigram index of a file if it exists and was built from the file as it is now, judged by its
+ * size and modification time.
+ *
+ * @param filename The indexed file
+ * @param index The index to fill in
+ * @return The index was mapped
+ */
+bool openTrigramIndex(char *filename, TrigramIndex *index)
+{
+    struct stat sourceStatus;
+    if (stat(filename, &sourceStatus) < 0) {
+        return false;
+    }
+
+    char *indexFilename = trigramIndexFilename(filename);
+    bool mapped = mapFile(indexFilename, &index->mapping);
+    free(indexFilename);
+    if (!mapped) {
+        return false;
+    }
+
+    index->header = (const TrigramIndexHeader *) index->mapping.data;
+    if (index->mapping.size < sizeof(TrigramIndexHeader)
+            || memcmp(index->header->magic, TRIGRAM_INDEX_MAGIC, sizeof(index->header->magic)) != 0
+            || index->header->sourceSize != (uint64_t) sourceStatus.st_size
+            || index->header->sourceModifiedSeconds != sourceStatus.st_mtim.tv_sec
+            || index->header->sourceModifiedNanoseconds != sourceStatus.st_mtim.tv_nsec
+            || index->mapping.size != sizeof(TrigramIndexHeader) + index->header->rowsCount * sizeof(uint64_t)
+                                      + index->header->trigramCount * sizeof(TrigramEntry)
+                                      + index->header->postingsSize) {
+        unmapFile(&index->mapping);
+        return false;
+    }
+
+    index->rowOffsets = (const uint64_t *) (index->header + 1);
+    index->entries = (const TrigramEntry *) (index->rowOffsets + index->header->rowsCount);
+    index->postings = (const unsigned char *) (index->entries + index->header->trigramCount);
+
+    return true;
+}
+
+/**
+ * Searches a file for the search string using its trigram index. The rows holding every trigram of the
+ * search string are the candidates, and only those are searched.
+ *
+ * @param filename The file to search
+ * @param pattern What to search for
+ * @return Status code, or -1 if the file has no up to date index
+ */
+int searchWithTrigramIndex(char *filename, SearchPattern *pattern)
+{
+    TrigramIndex index;
+    if (!openTrigramIndex(filename, &index)) {
+        return -1;
+    }
+    MappedFile source;
+    if (!mapFile(filename, &source) || source.size != index.header->sourceSize) {
+        unmapFile(&index.mapping);
+        return -1;
+    }
+
+    size_t trigramCount = pattern->needleLength - 2;
+    const TrigramEntry **entries = malloc(trigramCount * sizeof(TrigramEntry *));
+    if (entries == NULL) {
+        printf("Error: malloc failed in searchWithTrigramIndex\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bool everyTrigramFound = true;
+    const unsigned char *needle = (const unsigned char *) pattern->needle;
+    for (size_t i = 0; i < trigramCount && everyTrigramFound; ++i) {
+        uint32_t trigram = ((uint32_t) needle[i] << 16) | ((uint32_t) needle[i + 1] << 8) | needle[i + 2];
+        entries[i] = findTrigram(&index, trigram);
+        everyTrigramFound = entries[i] != NULL;
+    }
+
+    if (everyTrigramFound) {
+        qsort(entries, trigramCount, sizeof(TrigramEntry *), compareTrigramEntries);
+        uint64_t *candidates = malloc(entries[0]->rowCount * sizeof(uint64_t));
+        if (candidates == NULL) {
+            printf("Error: malloc failed in searchWithTrigramIndex\n");
+            exit(EXIT_FAILURE);
+        }
+
+        const unsigned char *posting = index.postings + entries[0]->postingOffset;
+        uint64_t row = 0;
+        for (uint32_t i = 0; i < entries[0]->rowCount; ++i) {
+            uint64_t delta;
+            posting += decodeVarint(posting, &delta);
+            row += delta;
+            candidates[i] = row;
+        }
+        size_t candidateCount = entries[0]->rowCount;
+        for (size_t i = 1; i < trigramCount && candidateCount > 0; ++i) {
+            candidateCount = intersectPostings(&index, entries[i], candidates, candidateCount);
+        }
+
+        bool searching = true;
+        for (size_t i = 0; i < candidateCount && searching; ++i) {
+            uint64_t candidate = candidates[i];
+            const char *rowStart = source.data + index.rowOffsets[candidate];
+            const char *rowEnd = candidate + 1 < index.header->rowsCount
+                                 ? source.data + index.rowOffsets[candidate + 1] - 1
+                                 : source.data + source.size;
+            const char *occurrence = memmem(rowStart, rowEnd - rowStart, pattern->needle, pattern->needleLength);
+            while (occurrence != NULL && searching) {
+                SearchMatch match = { (long) candidate, occurrence - rowStart, occurrence, rowEnd - occurrence };
+                if (!(pattern->matchRules & MATCH_WHOLE_WORD)
+                        || isWholeWord(rowStart, rowEnd, occurrence, pattern->needleLength)) {
+                    searching = emitMatch(&match, 0);
+                }
+                occurrence = memmem(occurrence + 1, rowEnd - occurrence - 1, pattern->needle, pattern->needleLength);
+            }
+        }
+        free(candidates);
+    }
+
+    free(entries);
+    unmapFile(&source);
+    unmapFile(&index.mapping);
+
+    return 0;
+}
+
+/**
+ * Finds the entry of a trigram with a binary search over the sorted entries.
+ *
+ * @param index The index
+ * @param trigram The trigram
+ * @return The entry, or NULL if the trigram does not occur
+ */
+const TrigramEntry *findTrigram(const TrigramIndex *index, uint32_t trigram)
+{
+    size_t low = 0;
+    size_t high = index->header->trigramCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (index->entries[middle].trigram < trigram) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low < index->header->trigramCount && index->entries[low].trigram == trigram ? &index->entries[low] : NULL;
+}
+
+/**
+ * Orders trigram entries by their amount of rows, so the shortest posting list is intersected first.
+ *
+ * @param first Pointer to the first entry
+ * @param second Pointer to the second entry
+ * @return Order of the entries
+ */
+int compareTrigramEntries(const void *first, const void *second)
+{
+    uint32_t firstCount = (*(const TrigramEntry **) first)->rowCount;
+    uint32_t secondCount = (*(const TrigramEntry **) second)->rowCount;
+
+    return firstCount < secondCount ? -1 : firstCount > secondCount;
+}
+
+/**
+ * Keeps the candidate rows that are in the posting list of a trigram. Both are sorted, so they are merged.
+ *
+ * @param index The index
+ * @param entry The entry of the trigram
+ * @param candidates The sorted candidate rows
+ * @param candidateCount The amount of candidate rows
+ * @return The amount of remaining candidate rows
+ */
+size_t intersectPostings(const TrigramIndex *index, const TrigramEntry *entry, uint64_t *candidates,
+                         size_t candidateCount)
+{
+    const unsigned char *posting = index->postings + entry->postingOffset;
+    uint64_t row = 0;
+    uint32_t remainingRows = entry->rowCount;
+    size_t kept = 0;
+    size_t candidate = 0;
+    bool rowLoaded = false;
+    while (candidate < candidateCount) {
+        if (!rowLoaded) {
+            if (remainingRows == 0) {
+                break;
+            }
+            uint64_t delta;
+            posting += decodeVarint(posting, &delta);
+            row += delta;
+            remainingRows--;
+            rowLoaded = true;
+        }
+
+        if (row < candidates[candidate]) {
+            rowLoaded = false;
+        } else if (row > candidates[candidate]) {
+            candidate++;
+        } else {
+            candidates[kept++] = row;
+            candidate++;
+            rowLoaded = false;
+        }
+    }
+
+    return kept;
+}
+
+/**
+ * Gets the amount of bytes a value takes as a varint, 7 bits for each byte.
+ *
+ * @param value The value
+ * @return The amount of bytes
+ */
+size_t varintLength(uint64_t value)
+{
+    size_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+
+    return length;
+}
+
+/**
+ * Encodes a value as a varint.
+ *
+ * @param bytes Where to write the varint
+ * @param value The value
+ * @return The amount of bytes written
+ */
+size_t encodeVarint(unsigned char *bytes, uint64_t value)
+{
+    size_t length = 0;
+    while (value >= 0x80) {
+        bytes[length++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    bytes[length++] = (unsigned char) value;
+
+    return length;
+}
+
+/**
+ * Decodes a varint.
+ *
+ * @param bytes The varint
+ * @param value Pointer to the decoded value
+ * @return The amount of bytes read
+ */
+size_t decodeVarint(const unsigned char *bytes, uint64_t *value)
+{
+    size_t length = 0;
+    int shift = 0;
+    *value = 0;
+    do {
+        *value |= (uint64_t) (bytes[length] & 0x7f) << shift;
+        shift += 7;
+    } while (bytes[length++] & 0x80);
+
+    return length;
+}
+
+/**
+ * Gets the seconds passed since a point in time on the monotonic clock.
+ *
+ * @param start The point in time
+ * @return The seconds passed
+ */
+double secondsSince(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * Prints the time of a search process or thread to stderr.
+ *
+ * @param workerNumber The number of the search process or thread
+ * @param time The time
+ */
+void printWorkerTime(int workerNumber, WorkerTime *time)
+{
+    fprintf(stderr, "Search worker %d: %.6f s wall, %.6f s cpu\n", workerNumber, time->wallSeconds,
+            time->cpuSeconds);
+}
@@ -0,0 +1,576 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <libgen.h>
+#include <sys/resource.h>
+
+#define SEARCH_PROGRAM "laborations_lab1_task2"
+#define BENCH_NEEDLE "QXZZYQX"
+#define MAX_LIST_ITEMS 32
+#define MAX_WORKERS 256
+#define OUTPUT_BUFFER_SIZE 65536
+#define HELP() printf("-----------------------------------\
+\nThis is a benchmark of the file search, reporting its throughput for each mode, kernel, matching rule\n"\
+"and amount of search processes.\n\n"\
+"Usage:\n\t[main.c] [-b program] [-s megabytes] [-l length] [-d density] [-j processes] [-k kernels]\n" \
+"\t\t[-M modes] [-R rules] [-r runs] [-o format] [-c corpus -n searchstring] [-S seed]\n\n" \
+"\t-b program\n\t\tThe search program, defaults to " SEARCH_PROGRAM " next to the benchmark\n" \
+"\t-s megabytes\n\t\tSize of the generated corpus, defaults to 64\n" \
+"\t-l length\n\t\tAverage row length of the generated corpus, defaults to 80\n" \
+"\t-d density\n\t\tShare of rows of the generated corpus holding a match, defaults to 0.01\n" \
+"\t-j processes\n\t\tComma separated amounts of search processes, defaults to powers of two up to the CPUs\n" \
+"\t-k kernels\n\t\tComma separated search kernels, defaults to scalar,sse2,avx2\n" \
+"\t-M modes\n\t\tComma separated modes: rows, mmap and stream, defaults to all of them\n" \
+"\t-R rules\n\t\tComma separated matching rules: exact, folded, word and folded-word, defaults to exact,folded.\n" \
+"\t\tWhole word rules are skipped in the stream mode\n" \
+"\t-r runs\n\t\tRuns of each combination, defaults to 3\n" \
+"\t-o format\n\t\tcsv or json, defaults to csv\n" \
+"\t-c corpus -n searchstring\n\t\tSearch an existing file instead of a generated corpus\n" \
+"\t-S seed\n\t\tSeed of the generated corpus, defaults to 1\n\n" \
+"\tExample:\n\t\tmain.c -s 256 -j 1,4 -k avx2 -o json\n-----------------------------------\n")
+
+typedef struct {
+    char *items[MAX_LIST_ITEMS];
+    int count;
+} OptionList;
+
+typedef struct {
+    double seconds;
+    long matches;
+    long peakRssKilobytes;
+    int workerCount;
+    double workerWallSeconds[MAX_WORKERS];
+    double workerCpuSeconds[MAX_WORKERS];
+    bool succeeded;
+} RunResult;
+
+typedef struct {
+    const char *mode;
+    const char *kernel;
+    const char *rules;
+    int workers;
+    int run;
+    size_t bytes;
+} RunCase;
+
+bool splitOptionList(char *list, OptionList *optionList);
+char *defaultSearchProgram(char *benchPath);
+bool addRuleArguments(const char *rules, char **arguments, int *argumentCount);
+void defaultWorkerCounts(OptionList *workerCounts, char *buffer, size_t bufferSize);
+bool generateCorpus(char *filename, size_t size, int lineLength, double density, uint64_t seed);
+uint64_t nextRandom(uint64_t *state);
+bool runSearch(char *program, char **arguments, RunResult *result);
+long countOutputRows(int outputPipe);
+void parseWorkerTimes(FILE *errorFile, RunResult *result);
+void printResultHeader(bool json);
+void printResult(RunCase *runCase, RunResult *result, bool json, bool first);
+double secondsSince(struct timespec *start);
+
+/**
+ * Benchmarks the file search over a generated or given corpus.
+ *
+ * @param argc Arguments count
+ * @param argv Arguments
+ * @return Status code
+ */
+int main(int argc, char **argv)
+{
+    char *program = NULL;
+    size_t megabytes = 64;
+    int lineLength = 80;
+    double density = 0.01;
+    int runs = 3;
+    bool json = false;
+    char *corpus = NULL;
+    char *needle = BENCH_NEEDLE;
+    uint64_t seed = 1;
+    char workerBuffer[128];
+    char kernelBuffer[] = "scalar,sse2,avx2";
+    char modeBuffer[] = "rows,mmap,stream";
+    char ruleBuffer[] = "exact,folded";
+    OptionList workerCounts = { .count = 0 };
+    OptionList kernels;
+    OptionList modes;
+    OptionList rules;
+    splitOptionList(kernelBuffer, &kernels);
+    splitOptionList(modeBuffer, &modes);
+    splitOptionList(ruleBuffer, &rules);
+
+    int option;
+    while ((option = getopt(argc, argv, "b:s:l:d:j:k:M:R:r:o:c:n:S:")) != -1) {
+        bool valid = true;
+        if (option == 'b') {
+            program = optarg;
+        } else if (option == 's') {
+            megabytes = strtoul(optarg, NULL, 10);
+            valid = megabytes > 0;
+        } else if (option == 'l') {
+            lineLength = atoi(optarg);
+            valid = lineLength > 0;
+        } else if (option == 'd') {
+            density = atof(optarg);
+            valid = density >= 0 && density <= 1;
+        } else if (option == 'j') {
+            valid = splitOptionList(optarg, &workerCounts);
+        } else if (option == 'k') {
+            valid = splitOptionList(optarg, &kernels);
+        } else if (option == 'M') {
+            valid = splitOptionList(optarg, &modes);
+        } else if (option == 'R') {
+            valid = splitOptionList(optarg, &rules);
+        } else if (option == 'r') {
+            runs = atoi(optarg);
+            valid = runs > 0;
+        } else if (option == 'o') {
+            json = strcmp(optarg, "json") == 0;
+            valid = json || strcmp(optarg, "csv") == 0;
+        } else if (option == 'c') {
+            corpus = optarg;
+        } else if (option == 'n') {
+            needle = optarg;
+        } else if (option == 'S') {
+            seed = strtoull(optarg, NULL, 10);
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            HELP();
+            return 1;
+        }
+    }
+
+    if (program == NULL) {
+        program = defaultSearchProgram(argv[0]);
+    }
+    if (workerCounts.count == 0) {
+        defaultWorkerCounts(&workerCounts, workerBuffer, sizeof(workerBuffer));
+    }
+
+    char generatedCorpus[] = "/tmp/lab1_task2_bench_XXXXXX";
+    if (corpus == NULL) {
+        int fileDescriptor = mkstemp(generatedCorpus);
+        if (fileDescriptor < 0) {
+            perror("mkstemp");
+            return 1;
+        }
+        close(fileDescriptor);
+        corpus = generatedCorpus;
+        fprintf(stderr, "Generating a %zu MB corpus in %s..\n", megabytes, corpus);
+        if (!generateCorpus(corpus, megabytes << 20, lineLength, density, seed)) {
+            fprintf(stderr, "Error generating corpus. Exiting..\n");
+            unlink(corpus);
+            return 1;
+        }
+    }
+
+    FILE *corpusFile = fopen(corpus, "rb");
+    if (corpusFile == NULL) {
+        printf("Error opening corpus. Exiting..");
+        return 1;
+    }
+    fseek(corpusFile, 0, SEEK_END);
+    size_t corpusSize = (size_t) ftell(corpusFile);
+    fclose(corpusFile);
+
+    int status = 0;
+    bool first = true;
+    printResultHeader(json);
+    for (int mode = 0; mode < modes.count; ++mode) {
+        bool streaming = strcmp(modes.items[mode], "stream") == 0;
+        for (int kernel = 0; kernel < kernels.count; ++kernel) {
+            for (int rule = 0; rule < rules.count; ++rule) {
+                if (streaming && strstr(rules.items[rule], "word") != NULL) {
+                    continue;
+                }
+                for (int workers = 0; workers < workerCounts.count; ++workers) {
+                    for (int run = 0; run < runs; ++run) {
+                        char *arguments[16];
+                        int argumentCount = 0;
+                        arguments[argumentCount++] = program;
+                        arguments[argumentCount++] = "-t";
+                        if (strcmp(modes.items[mode], "mmap") == 0) {
+                            arguments[argumentCount++] = "-m";
+                        } else if (streaming) {
+                            arguments[argumentCount++] = "-s";
+                        }
+                        if (!addRuleArguments(rules.items[rule], arguments, &argumentCount)) {
+                            fprintf(stderr, "%s is not a matching rule\n", rules.items[rule]);
+                            status = 1;
+                            break;
+                        }
+                        arguments[argumentCount++] = "-k";
+                        arguments[argumentCount++] = kernels.items[kernel];
+                        arguments[argumentCount++] = "-j";
+                        arguments[argumentCount++] = workerCounts.items[workers];
+                        arguments[argumentCount++] = corpus;
+                        arguments[argumentCount++] = needle;
+                        arguments[argumentCount] = NULL;
+
+                        RunCase runCase = {
+                                modes.items[mode], kernels.items[kernel], rules.items[rule],
+                                atoi(workerCounts.items[workers]), run + 1, corpusSize
+                        };
+                        RunResult result;
+                        if (!runSearch(program, arguments, &result)) {
+                            status = 1;
+                        }
+                        printResult(&runCase, &result, json, first);
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+    if (json) {
+        printf("\n]\n");
+    }
+
+    if (corpus == generatedCorpus) {
+        unlink(corpus);
+    }
+
+    return status;
+}
+
+/**
+ * Splits a comma separated option in place.
+ *
+ * @param list The comma separated option
+ * @param optionList The items of the option
+ * @return The option had at least one and at most MAX_LIST_ITEMS items
+ */
+bool splitOptionList(char *list, OptionList *optionList)
+{
+    char *pointerToEndOfItem;
+    optionList->count = 0;
+    char *item = strtok_r(list, ",", &pointerToEndOfItem);
+    while (item != NULL) {
+        if (optionList->count == MAX_LIST_ITEMS) {
+            return false;
+        }
+        optionList->items[optionList->count++] = item;
+        item = strtok_r(NULL, ",", &pointerToEndOfItem);
+    }
+
+    return optionList->count > 0;
+}
+
+/**
+ * Adds the options of a matching rule to the arguments of the search program.
+ *
+ * @param rules exact, folded, word or folded-word
+ * @param arguments The arguments
+ * @param argumentCount Pointer to the amount of arguments
+ * @return The matching rule is known
+ */
+bool addRuleArguments(const char *rules, char **arguments, int *argumentCount)
+{
+    bool folded = strcmp(rules, "folded") == 0 || strcmp(rules, "folded-word") == 0;
+    bool word = strcmp(rules, "word") == 0 || strcmp(rules, "folded-word") == 0;
+    if (folded) {
+        arguments[(*argumentCount)++] = "-i";
+    }
+    if (word) {
+        arguments[(*argumentCount)++] = "-w";
+    }
+
+    return folded || word || strcmp(rules, "exact") == 0;
+}
+
+/**
+ * Gets the path of the search program next to the benchmark.
+ *
+ * @param benchPath The path the benchmark was started with
+ * @return The allocated path of the search program
+ */
+char *defaultSearchProgram(char *benchPath)
+{
+    char *benchCopy = strdup(benchPath);
+    char *directory = dirname(benchCopy);
+    char *program = malloc(strlen(directory) + strlen(SEARCH_PROGRAM) + 2);
+    if (program == NULL) {
+        printf("Error: malloc failed in defaultSearchProgram\n");
+        exit(EXIT_FAILURE);
+    }
+    sprintf(program, "%s/%s", directory, SEARCH_PROGRAM);
+    free(benchCopy);
+
+    return program;
+}
+
+/**
+ * Lists the powers of two up to the amount of online CPUs, and the amount of online CPUs.
+ *
+ * @param workerCounts The list of amounts of search processes
+ * @param buffer Buffer for the items of the list
+ * @param bufferSize The size of the buffer
+ */
+void defaultWorkerCounts(OptionList *workerCounts, char *buffer, size_t bufferSize)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t used = 0;
+    buffer[0] = '\0';
+    for (long workers = 1; workers < cpus && used < bufferSize; workers *= 2) {
+        used += snprintf(buffer + used, bufferSize - used, "%ld,", workers);
+    }
+    if (used < bufferSize) {
+        snprintf(buffer + used, bufferSize - used, "%ld", cpus > 0 ? cpus : 1);
+    }
+    splitOptionList(buffer, workerCounts);
+}
+
+/**
+ * Generates a corpus of rows of random lowercase words. The row lengths are spread evenly up to twice the
+ * average, and the given share of rows hold the benchmark search string at a random column.
+ *
+ * @param filename The corpus file
+ * @param size The size of the corpus in bytes
+ * @param lineLength The average row length
+ * @param density The share of rows holding a match
+ * @param seed The seed of the random generator
+ * @return The corpus was generated
+ */
+bool generateCorpus(char *filename, size_t size, int lineLength, double density, uint64_t seed)
+{
+    FILE *filePointer = fopen(filename, "wb");
+    if (!filePointer) {
+        return false;
+    }
+
+    const char alphabet[] = "abcdefghijklmnopqrstuvwxyz    ";
+    size_t needleLength = strlen(BENCH_NEEDLE);
+    uint64_t matchThreshold = (uint64_t) (density * (double) UINT32_MAX);
+    uint64_t state = seed != 0 ? seed : 1;
+    char *row = malloc(2 * lineLength + needleLength + 1);
+    if (row == NULL) {
+        printf("Error: malloc failed in generateCorpus\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t written = 0;
+    while (written < size) {
+        size_t rowLength = nextRandom(&state) % (2 * lineLength - 1);
+        for (size_t i = 0; i < rowLength; ++i) {
+            row[i] = alphabet[nextRandom(&state) % (sizeof(alphabet) - 1)];
+        }
+        if ((nextRandom(&state) & UINT32_MAX) < matchThreshold) {
+            size_t column = rowLength > 0 ? nextRandom(&state) % rowLength : 0;
+            memmove(row + column + needleLength, row + column, rowLength - column);
+            memcpy(row + column, BENCH_NEEDLE, needleLength);
+            rowLength += needleLength;
+        }
+        row[rowLength++] = '\n';
+
+        if (fwrite(row, 1, rowLength, filePointer) != rowLength) {
+            free(row);
+            fclose(filePointer);
+            return false;
+        }
+        written += rowLength;
+    }
+    free(row);
+
+    return fclose(filePointer) == 0;
+}
+
+/**
+ * Gets the next number of a xorshift random generator.
+ *
+ * @param state The state of the generator
+ * @return The next number
+ */
+uint64_t nextRandom(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+/**
+ * Runs the search program in a child process, counts the rows it prints, and collects its time, peak
+ * resident memory and the times it reports for each search process.
+ *
+ * @param program The search program
+ * @param arguments The arguments of the search program
+ * @param result The result of the run
+ * @return The search program succeeded
+ */
+bool runSearch(char *program, char **arguments, RunResult *result)
+{
+    memset(result, 0, sizeof(RunResult));
+    int outputPipe[2];
+    FILE *errorFile = tmpfile();
+    if (errorFile == NULL || pipe(outputPipe) < 0) {
+        perror("Error creating run output");
+        return false;
+    }
+
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Fork Failed");
+        return false;
+    } else if (pid == 0) { /* child process */
+        dup2(outputPipe[1], STDOUT_FILENO);
+        dup2(fileno(errorFile), STDERR_FILENO);
+        close(outputPipe[0]);
+        close(outputPipe[1]);
+        execv(program, arguments);
+        perror(program);
+        _exit(127);
+    }
+
+    /* parent process */
+    close(outputPipe[1]);
+    result->matches = countOutputRows(outputPipe[0]);
+    close(outputPipe[0]);
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    result->seconds = secondsSince(&startTime);
+    result->peakRssKilobytes = usage.ru_maxrss;
+    result->succeeded = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    parseWorkerTimes(errorFile, result);
+    fclose(errorFile);
+    if (!result->succeeded) {
+        fprintf(stderr, "%s failed with status %d\n", program, status);
+    }
+
+    return result->succeeded;
+}
+
+/**
+ * Reads the output of the search program until it ends, and counts its rows.
+ *
+ * @param outputPipe The output of the search program
+ * @return The amount of rows
+ */
+long countOutputRows(int outputPipe)
+{
+    static char buffer[OUTPUT_BUFFER_SIZE];
+    long rows = 0;
+    ssize_t bytesRead;
+    while ((bytesRead = read(outputPipe, buffer, sizeof(buffer))) != 0) {
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (const char *position = buffer; (position = memchr(position, '\n', buffer + bytesRead - position)) != NULL;
+             ++position) {
+            rows++;
+        }
+    }
+
+    return rows;
+}
+
+/**
+ * Reads the times the search program reported for each of its search processes or threads.
+ *
+ * @param errorFile The error output of the search program
+ * @param result The result of the run
+ */
+void parseWorkerTimes(FILE *errorFile, RunResult *result)
+{
+    char line[256];
+    rewind(errorFile);
+    while (fgets(line, sizeof(line), errorFile) != NULL) {
+        int worker;
+        double wallSeconds;
+        double cpuSeconds;
+        if (sscanf(line, "Search worker %d: %lf s wall, %lf s cpu", &worker, &wallSeconds, &cpuSeconds) == 3) {
+            if (result->workerCount < MAX_WORKERS) {
+                result->workerWallSeconds[result->workerCount] = wallSeconds;
+                result->workerCpuSeconds[result->workerCount] = cpuSeconds;
+                result->workerCount++;
+            }
+        } else {
+            fputs(line, stderr);
+        }
+    }
+}
+
+/**
+ * Prints the CSV header, or opens the JSON array.
+ *
+ * @param json Print JSON
+ */
+void printResultHeader(bool json)
+{
+    if (json) {
+        printf("[");
+    } else {
+        printf("mode,kernel,rules,workers,run,bytes,seconds,gb_per_second,matches,matches_per_second,peak_rss_kb,"
+               "worker_wall_seconds,worker_cpu_seconds\n");
+    }
+}
+
+/**
+ * Prints the result of a run as a CSV row or a JSON object. The times of the search processes are
+ * separated by semicolons in CSV.
+ *
+ * @param runCase What was run
+ * @param result The result of the run
+ * @param json Print JSON
+ * @param first The result is the first one printed
+ */
+void printResult(RunCase *runCase, RunResult *result, bool json, bool first)
+{
+    double gigabytesPerSecond = result->seconds > 0 ? runCase->bytes / result->seconds / 1e9 : 0;
+    double matchesPerSecond = result->seconds > 0 ? result->matches / result->seconds : 0;
+    const char *separator = json ? "," : ";";
+
+    if (json) {
+        printf("%s\n  {\"mode\": \"%s\", \"kernel\": \"%s\", \"rules\": \"%s\", \"workers\": %d, \"run\": %d, \"bytes\": %zu, "
+               "\"seconds\": %.6f, \"gb_per_second\": %.4f, \"matches\": %ld, \"matches_per_second\": %.1f, "
+               "\"peak_rss_kb\": %ld, \"succeeded\": %s, \"worker_wall_seconds\": [",
+               first ? "" : ",", runCase->mode, runCase->kernel, runCase->rules, runCase->workers, runCase->run, runCase->bytes,
+               result->seconds, gigabytesPerSecond, result->matches, matchesPerSecond, result->peakRssKilobytes,
+               result->succeeded ? "true" : "false");
+    } else {
+        printf("%s,%s,%s,%d,%d,%zu,%.6f,%.4f,%ld,%.1f,%ld,", runCase->mode, runCase->kernel, runCase->rules,
+               runCase->workers, runCase->run, runCase->bytes, result->seconds, gigabytesPerSecond, result->matches,
+               matchesPerSecond, result->peakRssKilobytes);
+    }
+
+    for (int i = 0; i < result->workerCount; ++i) {
+        printf("%s%.6f", i > 0 ? separator : "", result->workerWallSeconds[i]);
+    }
+    printf(json ? "], \"worker_cpu_seconds\": [" : ",");
+    for (int i = 0; i < result->workerCount; ++i) {
+        printf("%s%.6f", i > 0 ? separator : "", result->workerCpuSeconds[i]);
+    }
+    printf(json ? "]}" : "\n");
+    fflush(stdout);
+}
+
+/**
+ * Gets the seconds passed since a point in time on the monotonic clock.
+ *
+ * @param start The point in time
+ * @return The seconds passed
+ */
+double secondsSince(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
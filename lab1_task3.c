@@ -6,15 +6,142 @@
 #include <sys/wait.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <sys/mman.h>
 
+#define LEAF_RANGE_SIZE 32
+#define KARATSUBA_THRESHOLD 32
+#define NTT_THRESHOLD 2048
+#define MAX_NTT_LENGTH (1 << 23)
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+#define DECIMAL_BASECASE_LIMBS 32
+#define MAX_DECIMAL_POWERS 40
 #define HELP() printf("-----------------------------------\
 \nThis is a script that calculates the factorial of a number N using a child process.\
-\nIt can handle up to 20!\n\n"\
-"Usage:\n\t[main.c] [N]\n\n" \
+\nThe factorials are exact for any N.\n\n"\
+"Usage:\n\t[main.c] [-f] [-s] [-j processes] [--digits | --first K | --last K] [N]\n\n" \
+"\t-s, --summary\n\t\tOnly print the whole series and its sum, not each step\n" \
+"\t-f, --factorial\n\t\tOnly print N!, computed as a product tree of the range 1..N\n" \
+"\t-j processes\n\t\tAmount of processes computing N! with -f, defaults to the amount of online CPUs\n" \
+"\t--digits\n\t\tOnly print the amount of digits of N!\n" \
+"\t--first K, --last K\n\t\tOnly print the first or last K digits of N!, or both with ... between them\n\n" \
 "\tExample:\n\t\tmain.c 5\n-----------------------------------\n");
 
+/* An unsigned integer of any size, with its least significant 32-bit limb first and no leading zero limbs.
+ * Zero has no limbs. */
+typedef struct {
+    uint32_t *limbs;
+    size_t length;
+} BigNumber;
+
+/* The limbs of the numbers of a computation, allocated once. Limbs are taken from the top and given back
+ * by resetting the top to a mark taken earlier, so temporaries cost no allocations. */
+typedef struct {
+    uint32_t *limbs;
+    size_t capacity;
+    size_t used;
+} LimbArena;
+
+/* A prime for number theoretic transforms, below 2^30 and with a primitive root, along with what
+ * Montgomery multiplication modulo the prime needs. */
+typedef struct {
+    uint32_t modulus;
+    uint32_t primitiveRoot;
+    uint32_t negatedInverse;
+    uint32_t montgomerySquare;
+} NttPrime;
+
+/* Text collected in memory. A buffer with a file descriptor is written to it with one write when it is full
+ * and when it is flushed, and a buffer without one grows instead. */
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+    int fileDescriptor;
+} TextBuffer;
+
+/* The powers 10^(9 * 2^j) by which numbers are split to be formatted in decimal, each the square of the one
+ * before, and their reciprocals floor(2^(64k) / power), where k is the amount of limbs of the power. They
+ * are kept for every number formatted. */
+typedef struct {
+    BigNumber powers[MAX_DECIMAL_POWERS];
+    BigNumber reciprocals[MAX_DECIMAL_POWERS];
+    int count;
+} DecimalPowers;
+
+/* The partial products of N!, in memory shared by the processes computing them. Each range of 1..N has a
+ * region for its product and the scratch space of the multiplications, and two products are multiplied
+ * into the region of the first, so partial products are never copied between processes. Only the lengths
+ * of the products are in the mapping besides the regions. */
+typedef struct {
+    size_t *lengths;
+    uint32_t *limbs;
+    size_t mappingSize;
+    size_t *offsets;
+    size_t *capacities;
+    uint32_t *boundaries;
+    int rangeCount;
+} SharedProducts;
+
+NttPrime nttPrimes[2] = { { 998244353, 3, 0, 0 }, { 469762049, 3, 0, 0 } };
+DecimalPowers decimalPowers = { .count = 0 };
+LimbArena conversionArena = { NULL, 0, 0 };
+bool printDigitCount = false;
+size_t leadingDigitCount = 0;
+size_t trailingDigitCount = 0;
+
 bool isNumericInput(char input[]);
-int calculateFactorialInChildProcess(long long int N);
+int calculateFactorialInChildProcess(long long int N, bool factorialOnly, bool summaryOnly, long processCount);
+void printFactorialSeries(uint32_t n, bool summaryOnly);
+void printFactorial(uint32_t n, long processCount);
+size_t estimateFactorialLimbs(uint32_t n);
+BigNumber computeFactorialInParallel(uint32_t n, int rangeCount, SharedProducts *products);
+void createSharedProducts(SharedProducts *products, uint32_t n, int rangeCount);
+void multiplySharedProducts(SharedProducts *products, int first, int second);
+void waitForProducts(int processCount);
+void createLimbArena(LimbArena *arena, size_t capacity);
+uint32_t *allocateLimbs(LimbArena *arena, size_t count);
+BigNumber computeFactorial(LimbArena *arena, uint32_t n);
+BigNumber multiplyRange(LimbArena *arena, uint32_t low, uint32_t high);
+void multiplyLimbs(LimbArena *arena, const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                   uint32_t *result);
+void multiplySchoolbook(const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength, uint32_t *result);
+void multiplyKaratsuba(LimbArena *arena, const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                       uint32_t *result);
+void multiplyNtt(LimbArena *arena, const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                 uint32_t *result);
+void convolveModulo(LimbArena *arena, const NttPrime *prime, const uint32_t *a, size_t aLength, const uint32_t *b,
+                    size_t bLength, uint32_t *convolution, size_t transformLength);
+void transformNtt(const NttPrime *prime, uint32_t *values, size_t length, const uint32_t *roots);
+void inverseTransformNtt(const NttPrime *prime, uint32_t *values, size_t length, const uint32_t *roots);
+void initializeNttPrime(NttPrime *prime);
+uint32_t reduceMontgomery(const NttPrime *prime, uint64_t value);
+uint32_t powerModulo(uint32_t base, uint64_t exponent, uint32_t modulus);
+uint32_t addLimbs(uint32_t *sum, size_t sumLength, const uint32_t *addend, size_t addendLength);
+void subtractLimbs(uint32_t *difference, size_t differenceLength, const uint32_t *subtrahend,
+                   size_t subtrahendLength);
+size_t normalizedLength(const uint32_t *limbs, size_t length);
+BigNumber multiplyBySmall(const BigNumber *number, uint32_t factor);
+void addBigNumber(BigNumber *sum, const BigNumber *addend);
+void printBigNumberLine(const BigNumber *number);
+size_t formatBigNumber(const BigNumber *number, char *digits);
+size_t countDecimalDigits(const BigNumber *number);
+size_t writeDecimal(const uint32_t *limbs, size_t length, int level, char *digits, bool padded);
+size_t formatLimbs(const uint32_t *limbs, size_t length, char *digits, size_t width);
+int prepareDecimalPowers(size_t length);
+void addDecimalPower(void);
+size_t computeReciprocalError(const uint32_t *power, size_t length, const uint32_t *reciprocal,
+                              size_t reciprocalLength, uint32_t *error, uint32_t *product);
+void divideByDecimalPower(const uint32_t *limbs, size_t length, int level, BigNumber *quotient,
+                          BigNumber *remainder);
+size_t divideByBarrett(uint32_t *number, size_t length, int level, uint32_t *quotient);
+int compareLimbs(const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength);
+void createTextBuffer(TextBuffer *buffer, size_t capacity, int fileDescriptor);
+char *reserveText(TextBuffer *buffer, size_t extra);
+void appendText(TextBuffer *buffer, const char *text, size_t length);
+void appendBigNumber(TextBuffer *buffer, const BigNumber *number);
+void flushText(TextBuffer *buffer);
 
 /**
  * Calculates the factorial of a number N using a child process.
@@ -24,16 +151,63 @@ int calculateFactorialInChildProcess(long long int N);
  * @return Status code
  */
 int main(int argc, char **argv) {
-    if (argc != 2) {
+    bool factorialOnly = false;
+    bool summaryOnly = false;
+    long processCount = sysconf(_SC_NPROCESSORS_ONLN);
+    struct option longOptions[] = {
+            { "factorial", no_argument, NULL, 'f' },
+            { "summary", no_argument, NULL, 's' },
+            { "digits", no_argument, NULL, 'd' },
+            { "first", required_argument, NULL, 'a' },
+            { "last", required_argument, NULL, 'z' },
+            { NULL, 0, NULL, 0 }
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "fsj:", longOptions, NULL)) != -1) {
+        if (option == 'f') {
+            factorialOnly = true;
+        } else if (option == 's') {
+            summaryOnly = true;
+        } else if (option == 'd') {
+            printDigitCount = true;
+            factorialOnly = true;
+        } else if (option == 'a' || option == 'z') {
+            long digitCount = atol(optarg);
+            if (digitCount < 1) {
+                printf("%s is not a valid amount of digits, exiting..\n", optarg);
+                exit(1);
+            }
+            *(option == 'a' ? &leadingDigitCount : &trailingDigitCount) = digitCount;
+            factorialOnly = true;
+        } else if (option == 'j') {
+            processCount = atol(optarg);
+            if (processCount < 1) {
+                printf("%s is not a valid amount of processes, exiting..\n", optarg);
+                exit(1);
+            }
+        } else {
+            HELP()
+            exit(1);
+        }
+    }
+
+    if (argc - optind != 1) {
         HELP()
         exit(1);
-    } else if (!isNumericInput(argv[1])) {
-        printf("%s is not a number, exiting..\n", argv[1]);
+    } else if (!isNumericInput(argv[optind])) {
+        printf("%s is not a number, exiting..\n", argv[optind]);
         exit(1);
     }
 
-    long long int N = atoll(argv[1]);
-    calculateFactorialInChildProcess(N);
+    long long int N = atoll(argv[optind]);
+    if (strlen(argv[optind]) > 10 || N >= UINT32_MAX) {
+        printf("%s is too large, exiting..\n", argv[optind]);
+        exit(1);
+    }
+    if (processCount < 1) {
+        processCount = 1;
+    }
+    calculateFactorialInChildProcess(N, factorialOnly, summaryOnly, processCount);
     return 0;
 }
 
@@ -59,9 +233,12 @@ bool isNumericInput(char input[])
  * a child process.
  *
  * @param N Factorial number
+ * @param factorialOnly Only print N!
+ * @param summaryOnly Only print the whole series and its sum
+ * @param processCount The amount of processes computing N!
  * @return Status code
  */
-int calculateFactorialInChildProcess(long long int N)
+int calculateFactorialInChildProcess(long long int N, bool factorialOnly, bool summaryOnly, long processCount)
 {
     pid_t pid;
     pid = fork();
@@ -69,21 +246,10 @@ int calculateFactorialInChildProcess(long long int N)
         fprintf(stderr, "Fork Failed");
         return 1;
     } else if (pid == 0) { /* child process */
-        long long int factorial = 1;
-        long long int steps[N];
-        for (long long int i = 1; i <= N; ++i) {
-            factorial = factorial * i;
-            steps[i-1] = factorial;
-            for (long long int j = 0; j < i; ++j) {
-                printf("%lld ", steps[j]);
-            }
-            printf("\n");
-        }
-        printf("\nThe sum of the series is:\n");
-        long long int lastSum = 0;
-        for (long long int j = 0; j < N; ++j) {
-            lastSum += steps[j];
-            printf("%lld ",lastSum);
+        if (factorialOnly) {
+            printFactorial(N, processCount);
+        } else {
+            printFactorialSeries(N, summaryOnly);
         }
         exit(0);
     } else { /* parent process */
@@ -91,3 +257,1344 @@ int calculateFactorialInChildProcess(long long int N)
         return 0;
     }
 }
+
+/**
+ * Prints each step of the factorial of n with the steps before it, and the sums of the steps. Each step is
+ * formatted once and appended to the text of the series, so the line of a step is a copy of the start of
+ * that text.
+ *
+ * @param n Factorial number
+ * @param summaryOnly Only print the whole series and its sum
+ */
+void printFactorialSeries(uint32_t n, bool summaryOnly)
+{
+    TextBuffer output;
+    TextBuffer series;
+    TextBuffer sums;
+    createTextBuffer(&output, OUTPUT_BUFFER_SIZE, STDOUT_FILENO);
+    createTextBuffer(&series, 4096, -1);
+    createTextBuffer(&sums, 4096, -1);
+
+    BigNumber factorial = { malloc(sizeof(uint32_t)), 1 };
+    if (factorial.limbs == NULL) {
+        printf("Error: malloc failed in printFactorialSeries\n");
+        exit(EXIT_FAILURE);
+    }
+    factorial.limbs[0] = 1;
+    BigNumber lastSum = { NULL, 0 };
+    for (uint32_t i = 1; i <= n; ++i) {
+        BigNumber step = multiplyBySmall(&factorial, i);
+        free(factorial.limbs);
+        factorial = step;
+        addBigNumber(&lastSum, &factorial);
+
+        appendBigNumber(&series, &factorial);
+        appendText(&series, " ", 1);
+        if (!summaryOnly) {
+            appendText(&output, series.text, series.length);
+            appendText(&output, "\n", 1);
+            appendBigNumber(&sums, &lastSum);
+            appendText(&sums, " ", 1);
+        }
+    }
+
+    if (summaryOnly) {
+        appendText(&output, series.text, series.length);
+        appendText(&output, "\n", 1);
+        appendBigNumber(&sums, &lastSum);
+        appendText(&sums, "\n", 1);
+    }
+    const char *sumTitle = "\nThe sum of the series is:\n";
+    appendText(&output, sumTitle, strlen(sumTitle));
+    appendText(&output, sums.text, sums.length);
+    flushText(&output);
+
+    free(factorial.limbs);
+    free(lastSum.limbs);
+    free(output.text);
+    free(series.text);
+    free(sums.text);
+}
+
+/**
+ * Prints the factorial of n. Large factorials are computed by several processes, each multiplying a range
+ * of 1..n, and their products are multiplied in pairs by more processes until one is left.
+ *
+ * @param n Factorial number
+ * @param processCount The most processes to use
+ */
+void printFactorial(uint32_t n, long processCount)
+{
+    /* A range is only worth a process if it has at least a few thousand numbers */
+    int rangeCount = (int) (processCount < n / 4096 + 1 ? processCount : n / 4096 + 1);
+    if (rangeCount > 1) {
+        SharedProducts products;
+        BigNumber factorial = computeFactorialInParallel(n, rangeCount, &products);
+        printBigNumberLine(&factorial);
+        munmap(products.lengths, products.mappingSize);
+        free(products.offsets);
+        free(products.capacities);
+        free(products.boundaries);
+        return;
+    }
+
+    /* The multiplications need scratch space of a few times the result */
+    LimbArena arena;
+    createLimbArena(&arena, 20 * estimateFactorialLimbs(n) + 4096);
+    BigNumber factorial = computeFactorial(&arena, n);
+    printBigNumberLine(&factorial);
+    free(arena.limbs);
+}
+
+/**
+ * Estimates the amount of limbs of the factorial of n from above, with log2(n!) below n * log2(n).
+ *
+ * @param n Factorial number
+ * @return The estimate
+ */
+size_t estimateFactorialLimbs(uint32_t n)
+{
+    size_t bitLength = 1;
+    while (bitLength < 32 && (1u << bitLength) <= n) {
+        bitLength++;
+    }
+
+    return (size_t) n * bitLength / 32 + 2;
+}
+
+/**
+ * Computes the factorial of n with a child process per range of 1..n, which leaves the product of its
+ * range in shared memory. The products are then multiplied in pairs, with a child process per pair, in a
+ * balanced tree that halves the products each level.
+ *
+ * @param n Factorial number
+ * @param rangeCount The amount of ranges
+ * @param products The shared products, which the caller unmaps and deallocates
+ * @return The factorial, in the shared products
+ */
+BigNumber computeFactorialInParallel(uint32_t n, int rangeCount, SharedProducts *products)
+{
+    initializeNttPrime(&nttPrimes[0]);
+    initializeNttPrime(&nttPrimes[1]);
+    createSharedProducts(products, n, rangeCount);
+
+    fflush(stdout);
+    for (int i = 0; i < rangeCount; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Fork Failed");
+            exit(EXIT_FAILURE);
+        } else if (pid == 0) { /* child process */
+            LimbArena arena = { products->limbs + products->offsets[i], products->capacities[i], 0 };
+            BigNumber product = multiplyRange(&arena, products->boundaries[i], products->boundaries[i + 1]);
+            products->lengths[i] = product.length;
+            exit(0);
+        }
+    }
+    waitForProducts(rangeCount);
+
+    for (int step = 1; step < rangeCount; step *= 2) {
+        int processCount = 0;
+        for (int i = 0; i + step < rangeCount; i += 2 * step) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                fprintf(stderr, "Fork Failed");
+                exit(EXIT_FAILURE);
+            } else if (pid == 0) { /* child process */
+                multiplySharedProducts(products, i, i + step);
+                exit(0);
+            }
+            processCount++;
+        }
+        waitForProducts(processCount);
+    }
+
+    return (BigNumber) { products->limbs, products->lengths[0] };
+}
+
+/**
+ * Split 1..n into ranges whose products have about the same amount of bits, and map a region for each.
+ * The region of a range holds the product of the ranges it is multiplied with, and the scratch space of
+ * the multiplications. The mapping does not reserve swap, and only the pages used get memory.
+ *
+ * @param products The shared products
+ * @param n Factorial number
+ * @param rangeCount The amount of ranges
+ */
+void createSharedProducts(SharedProducts *products, uint32_t n, int rangeCount)
+{
+    products->rangeCount = rangeCount;
+    products->boundaries = malloc((rangeCount + 1) * sizeof(uint32_t));
+    products->offsets = malloc(rangeCount * sizeof(size_t));
+    products->capacities = malloc(rangeCount * sizeof(size_t));
+    size_t *rangeLimbs = malloc(rangeCount * sizeof(size_t));
+    if (products->boundaries == NULL || products->offsets == NULL || products->capacities == NULL
+        || rangeLimbs == NULL) {
+        printf("Error: malloc failed in createSharedProducts\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* The bit lengths of the numbers add up to a bound on the bits of the product of a range */
+    uint64_t totalBits = 0;
+    for (int bits = 1; bits <= 32; ++bits) {
+        uint64_t first = (uint64_t) 1 << (bits - 1);
+        uint64_t last = ((uint64_t) 1 << bits) - 1 < n ? ((uint64_t) 1 << bits) - 1 : n;
+        totalBits += first <= last ? (last - first + 1) * bits : 0;
+    }
+    uint64_t rangeBits = 0;
+    int range = 0;
+    products->boundaries[0] = 1;
+    for (uint32_t number = 1; number <= n; ++number) {
+        rangeBits += 32 - __builtin_clz(number);
+        if (range < rangeCount - 1 && rangeBits * rangeCount >= totalBits * (range + 1)) {
+            products->boundaries[++range] = number + 1;
+        }
+    }
+    while (range < rangeCount - 1) {
+        products->boundaries[++range] = n + 1;
+    }
+    products->boundaries[rangeCount] = n + 1;
+    for (int i = 0; i < rangeCount; ++i) {
+        rangeBits = 0;
+        for (uint32_t number = products->boundaries[i]; number < products->boundaries[i + 1]; ++number) {
+            rangeBits += 32 - __builtin_clz(number);
+        }
+        rangeLimbs[i] = rangeBits / 32 + 2;
+    }
+
+    /* A range is multiplied with the ranges after it until the step reaches the lowest set bit of its index */
+    size_t limbCount = 0;
+    for (int i = 0; i < rangeCount; ++i) {
+        int span = i == 0 ? rangeCount : i & -i;
+        size_t subtreeLimbs = 0;
+        for (int j = i; j < i + span && j < rangeCount; ++j) {
+            subtreeLimbs += rangeLimbs[j];
+        }
+        products->offsets[i] = limbCount;
+        products->capacities[i] = 20 * subtreeLimbs + 4096;
+        limbCount += products->capacities[i];
+    }
+    free(rangeLimbs);
+
+    size_t lengthsSize = (rangeCount * sizeof(size_t) + 63) / 64 * 64;
+    products->mappingSize = lengthsSize + limbCount * sizeof(uint32_t);
+    void *mapping = mmap(NULL, products->mappingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        printf("Error: mmap failed in createSharedProducts\n");
+        exit(EXIT_FAILURE);
+    }
+    products->lengths = mapping;
+    products->limbs = (uint32_t *) ((char *) mapping + lengthsSize);
+}
+
+/**
+ * Multiply the products of two ranges into the region of the first. The product is made above the first
+ * operand and moved down when it is done.
+ *
+ * @param products The shared products
+ * @param first The index of the first range
+ * @param second The index of the second range
+ */
+void multiplySharedProducts(SharedProducts *products, int first, int second)
+{
+    LimbArena arena = { products->limbs + products->offsets[first], products->capacities[first],
+                        products->lengths[first] };
+    uint32_t *firstLimbs = arena.limbs;
+    uint32_t *secondLimbs = products->limbs + products->offsets[second];
+    size_t length = products->lengths[first] + products->lengths[second];
+    uint32_t *product = allocateLimbs(&arena, length);
+    multiplyLimbs(&arena, firstLimbs, products->lengths[first], secondLimbs, products->lengths[second], product);
+    length = normalizedLength(product, length);
+
+    memmove(firstLimbs, product, length * sizeof(uint32_t));
+    products->lengths[first] = length;
+}
+
+/**
+ * Wait for the processes computing products, and exit if any of them failed.
+ *
+ * @param processCount The amount of processes
+ */
+void waitForProducts(int processCount)
+{
+    bool failed = false;
+    for (int i = 0; i < processCount; ++i) {
+        int status;
+        if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            failed = true;
+        }
+    }
+    if (failed) {
+        printf("Error: a process computing the factorial failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Allocate the limbs of an arena.
+ *
+ * @param arena The arena
+ * @param capacity The amount of limbs
+ */
+void createLimbArena(LimbArena *arena, size_t capacity)
+{
+    arena->limbs = malloc(capacity * sizeof(uint32_t));
+    if (arena->limbs == NULL) {
+        printf("Error: malloc failed in createLimbArena\n");
+        exit(EXIT_FAILURE);
+    }
+    arena->capacity = capacity;
+    arena->used = 0;
+}
+
+/**
+ * Take limbs from the top of an arena.
+ *
+ * @param arena The arena
+ * @param count The amount of limbs
+ * @return The limbs, which are not cleared
+ */
+uint32_t *allocateLimbs(LimbArena *arena, size_t count)
+{
+    if (count > arena->capacity - arena->used) {
+        printf("Error: arena exhausted in allocateLimbs\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t *limbs = arena->limbs + arena->used;
+    arena->used += count;
+
+    return limbs;
+}
+
+/**
+ * Computes the factorial of n.
+ *
+ * @param arena The arena, where the factorial is left at the mark it had
+ * @param n Factorial number
+ * @return The factorial
+ */
+BigNumber computeFactorial(LimbArena *arena, uint32_t n)
+{
+    initializeNttPrime(&nttPrimes[0]);
+    initializeNttPrime(&nttPrimes[1]);
+
+    return multiplyRange(arena, 1, n + 1);
+}
+
+/**
+ * Multiply the numbers of a range by splitting it in halves, so both operands of each multiplication have
+ * about the same size and the large ones are multiplied with Karatsuba or number theoretic transforms.
+ *
+ * @param arena The arena, where the product is left at the mark it had
+ * @param low The first number of the range
+ * @param high The number after the last number of the range
+ * @return The product, which is 1 for an empty range
+ */
+BigNumber multiplyRange(LimbArena *arena, uint32_t low, uint32_t high)
+{
+    size_t mark = arena->used;
+    if (high - low <= LEAF_RANGE_SIZE) {
+        uint32_t *limbs = allocateLimbs(arena, high - low + 1);
+        size_t length = 1;
+        limbs[0] = 1;
+        for (uint64_t number = low; number < high; ++number) {
+            /* Numbers are multiplied together while they fit in a limb, and the limb into the product */
+            uint64_t factor = number;
+            while (number + 1 < high && factor * (number + 1) <= UINT32_MAX) {
+                factor *= ++number;
+            }
+            uint64_t carry = 0;
+            for (size_t i = 0; i < length; ++i) {
+                carry += (uint64_t) limbs[i] * factor;
+                limbs[i] = (uint32_t) carry;
+                carry >>= 32;
+            }
+            if (carry != 0) {
+                limbs[length++] = (uint32_t) carry;
+            }
+        }
+        arena->used = mark + length;
+        return (BigNumber) { limbs, length };
+    }
+
+    uint32_t middle = low + (high - low) / 2;
+    BigNumber left = multiplyRange(arena, low, middle);
+    BigNumber right = multiplyRange(arena, middle, high);
+    uint32_t *product = allocateLimbs(arena, left.length + right.length);
+    multiplyLimbs(arena, left.limbs, left.length, right.limbs, right.length, product);
+    size_t length = normalizedLength(product, left.length + right.length);
+
+    memmove(arena->limbs + mark, product, length * sizeof(uint32_t));
+    arena->used = mark + length;
+
+    return (BigNumber) { arena->limbs + mark, length };
+}
+
+/**
+ * Multiply two numbers with the fastest method for their sizes. Operands of very different sizes are
+ * multiplied in pieces the size of the smaller one.
+ *
+ * @param arena The arena for temporaries, which are given back
+ * @param a The limbs of the first number
+ * @param aLength The amount of limbs of the first number, at least 1
+ * @param b The limbs of the second number
+ * @param bLength The amount of limbs of the second number, at least 1
+ * @param result The aLength + bLength limbs of the product, which may not overlap the operands
+ */
+void multiplyLimbs(LimbArena *arena, const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                   uint32_t *result)
+{
+    if (aLength < bLength) {
+        const uint32_t *swappedLimbs = a;
+        a = b;
+        b = swappedLimbs;
+        size_t swappedLength = aLength;
+        aLength = bLength;
+        bLength = swappedLength;
+    }
+
+    size_t transformLength = 1;
+    while (transformLength < 2 * (aLength + bLength)) {
+        transformLength *= 2;
+    }
+    if (bLength < KARATSUBA_THRESHOLD) {
+        multiplySchoolbook(a, aLength, b, bLength, result);
+    } else if (aLength >= 2 * bLength) {
+        size_t mark = arena->used;
+        uint32_t *piece = allocateLimbs(arena, 2 * bLength);
+        memset(result, 0, (aLength + bLength) * sizeof(uint32_t));
+        for (size_t offset = 0; offset < aLength; offset += bLength) {
+            size_t pieceLength = aLength - offset < bLength ? aLength - offset : bLength;
+            multiplyLimbs(arena, a + offset, pieceLength, b, bLength, piece);
+            addLimbs(result + offset, aLength + bLength - offset, piece, pieceLength + bLength);
+        }
+        arena->used = mark;
+    } else if (bLength >= NTT_THRESHOLD && transformLength <= MAX_NTT_LENGTH) {
+        multiplyNtt(arena, a, aLength, b, bLength, result);
+    } else {
+        multiplyKaratsuba(arena, a, aLength, b, bLength, result);
+    }
+}
+
+/**
+ * Multiply two numbers limb by limb.
+ *
+ * @param a The limbs of the first number
+ * @param aLength The amount of limbs of the first number
+ * @param b The limbs of the second number
+ * @param bLength The amount of limbs of the second number
+ * @param result The aLength + bLength limbs of the product
+ */
+void multiplySchoolbook(const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength, uint32_t *result)
+{
+    memset(result, 0, (aLength + bLength) * sizeof(uint32_t));
+    for (size_t i = 0; i < bLength; ++i) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < aLength; ++j) {
+            carry += (uint64_t) a[j] * b[i] + result[i + j];
+            result[i + j] = (uint32_t) carry;
+            carry >>= 32;
+        }
+        result[i + aLength] = (uint32_t) carry;
+    }
+}
+
+/**
+ * Multiply two numbers of about the same size with Karatsuba's method, which splits them in halves and
+ * needs three multiplications of halves instead of four.
+ *
+ * @param arena The arena for temporaries, which are given back
+ * @param a The limbs of the first number
+ * @param aLength The amount of limbs of the first number
+ * @param b The limbs of the second number
+ * @param bLength The amount of limbs of the second number, more than half of aLength and at most aLength
+ * @param result The aLength + bLength limbs of the product
+ */
+void multiplyKaratsuba(LimbArena *arena, const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                       uint32_t *result)
+{
+    size_t half = aLength / 2;
+    size_t aHighLength = aLength - half;
+    size_t bHighLength = bLength - half;
+
+    /* The product of the low halves and of the high halves go straight to their places in the result */
+    multiplyLimbs(arena, a, half, b, half, result);
+    multiplyLimbs(arena, a + half, aHighLength, b + half, bHighLength, result + 2 * half);
+
+    size_t mark = arena->used;
+    size_t aSumLength = aHighLength + 1;
+    size_t bSumLength = (half > bHighLength ? half : bHighLength) + 1;
+    uint32_t *aSum = allocateLimbs(arena, aSumLength);
+    uint32_t *bSum = allocateLimbs(arena, bSumLength);
+    uint32_t *middle = allocateLimbs(arena, aSumLength + bSumLength);
+    memcpy(aSum, a + half, aHighLength * sizeof(uint32_t));
+    aSum[aHighLength] = 0;
+    addLimbs(aSum, aSumLength, a, half);
+    memset(bSum, 0, bSumLength * sizeof(uint32_t));
+    memcpy(bSum, b + half, bHighLength * sizeof(uint32_t));
+    addLimbs(bSum, bSumLength, b, half);
+
+    /* (aLow + aHigh)(bLow + bHigh) - aLow bLow - aHigh bHigh is the middle part, which fits below the top */
+    multiplyLimbs(arena, aSum, aSumLength, bSum, bSumLength, middle);
+    subtractLimbs(middle, aSumLength + bSumLength, result, 2 * half);
+    subtractLimbs(middle, aSumLength + bSumLength, result + 2 * half, aHighLength + bHighLength);
+    size_t middleLength = aLength + bLength - half;
+    addLimbs(result + half, middleLength, middle, normalizedLength(middle, aSumLength + bSumLength));
+    arena->used = mark;
+}
+
+/**
+ * Multiply two large numbers by convolving their 16-bit digits with number theoretic transforms modulo two
+ * primes. A digit of the convolution is below the product of the primes, so it is recovered from its
+ * remainders with the Chinese remainder theorem.
+ *
+ * @param arena The arena for the transforms, which are given back
+ * @param a The limbs of the first number
+ * @param aLength The amount of limbs of the first number
+ * @param b The limbs of the second number
+ * @param bLength The amount of limbs of the second number
+ * @param result The aLength + bLength limbs of the product
+ */
+void multiplyNtt(LimbArena *arena, const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength,
+                 uint32_t *result)
+{
+    size_t digitCount = 2 * (aLength + bLength);
+    size_t transformLength = 1;
+    while (transformLength < digitCount) {
+        transformLength *= 2;
+    }
+
+    size_t mark = arena->used;
+    uint32_t *firstConvolution = allocateLimbs(arena, transformLength);
+    convolveModulo(arena, &nttPrimes[0], a, aLength, b, bLength, firstConvolution, transformLength);
+    uint32_t *secondConvolution = allocateLimbs(arena, transformLength);
+    convolveModulo(arena, &nttPrimes[1], a, aLength, b, bLength, secondConvolution, transformLength);
+
+    uint64_t firstModulus = nttPrimes[0].modulus;
+    uint64_t secondModulus = nttPrimes[1].modulus;
+    uint64_t firstInverse = powerModulo(firstModulus % secondModulus, secondModulus - 2, secondModulus);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < digitCount; ++i) {
+        uint64_t first = firstConvolution[i];
+        uint64_t correction = (secondConvolution[i] + secondModulus - first % secondModulus) % secondModulus;
+        carry += first + firstModulus * (correction * firstInverse % secondModulus);
+        if (i % 2 == 0) {
+            result[i / 2] = (uint32_t) (carry & 0xffff);
+        } else {
+            result[i / 2] |= (uint32_t) (carry & 0xffff) << 16;
+        }
+        carry >>= 16;
+    }
+    arena->used = mark;
+}
+
+/**
+ * Convolve the 16-bit digits of two numbers modulo a prime.
+ *
+ * @param arena The arena for the transform of the second number, which is given back
+ * @param prime The prime
+ * @param a The limbs of the first number
+ * @param aLength The amount of limbs of the first number
+ * @param b The limbs of the second number
+ * @param bLength The amount of limbs of the second number
+ * @param convolution The transformLength digits of the convolution
+ * @param transformLength The length of the transforms, a power of 2 of at least 2 * (aLength + bLength)
+ */
+void convolveModulo(LimbArena *arena, const NttPrime *prime, const uint32_t *a, size_t aLength, const uint32_t *b,
+                    size_t bLength, uint32_t *convolution, size_t transformLength)
+{
+    size_t mark = arena->used;
+    uint32_t *other = allocateLimbs(arena, transformLength);
+    uint32_t *roots = allocateLimbs(arena, transformLength);
+
+    /* roots[half + j] is the j:th power of a primitive 2 * half:th root of unity, in Montgomery form */
+    for (size_t half = 1; half < transformLength; half *= 2) {
+        uint32_t root = powerModulo(prime->primitiveRoot, (prime->modulus - 1) / (2 * half), prime->modulus);
+        uint32_t montgomeryRoot = reduceMontgomery(prime, (uint64_t) root * prime->montgomerySquare);
+        roots[half] = reduceMontgomery(prime, prime->montgomerySquare);
+        for (size_t j = 1; j < half; ++j) {
+            roots[half + j] = reduceMontgomery(prime, (uint64_t) roots[half + j - 1] * montgomeryRoot);
+        }
+    }
+
+    memset(convolution, 0, transformLength * sizeof(uint32_t));
+    memset(other, 0, transformLength * sizeof(uint32_t));
+    for (size_t i = 0; i < aLength; ++i) {
+        convolution[2 * i] = a[i] & 0xffff;
+        convolution[2 * i + 1] = a[i] >> 16;
+    }
+    for (size_t i = 0; i < bLength; ++i) {
+        other[2 * i] = b[i] & 0xffff;
+        other[2 * i + 1] = b[i] >> 16;
+    }
+    transformNtt(prime, convolution, transformLength, roots);
+    transformNtt(prime, other, transformLength, roots);
+
+    /* The transforms are in bit reversed order, which does not matter to the products. The Montgomery
+     * products are divided by 2^32, which the scaling by 1 / transformLength makes up for. */
+    for (size_t i = 0; i < transformLength; ++i) {
+        convolution[i] = reduceMontgomery(prime, (uint64_t) convolution[i] * other[i]);
+    }
+    inverseTransformNtt(prime, convolution, transformLength, roots);
+    uint64_t lengthInverse = powerModulo(transformLength % prime->modulus, prime->modulus - 2, prime->modulus);
+    uint32_t scale = (uint32_t) (lengthInverse * prime->montgomerySquare % prime->modulus);
+    for (size_t i = 0; i < transformLength; ++i) {
+        convolution[i] = reduceMontgomery(prime, (uint64_t) convolution[i] * scale);
+    }
+    arena->used = mark;
+}
+
+/**
+ * Transform values modulo a prime in place, with the butterflies of decimation in frequency. The
+ * transform is left in bit reversed order, so no permutation passes over the values.
+ *
+ * @param prime The prime
+ * @param values The values, below the prime
+ * @param length The amount of values, a power of 2
+ * @param roots The roots of unity, in Montgomery form
+ */
+void transformNtt(const NttPrime *prime, uint32_t *values, size_t length, const uint32_t *roots)
+{
+    uint32_t modulus = prime->modulus;
+    for (size_t half = length / 2; half >= 1; half /= 2) {
+        for (size_t start = 0; start < length; start += 2 * half) {
+            uint32_t *low = values + start;
+            uint32_t *high = values + start + half;
+            for (size_t j = 0; j < half; ++j) {
+                uint32_t sum = low[j] + high[j];
+                uint32_t difference = low[j] + modulus - high[j];
+                low[j] = sum >= modulus ? sum - modulus : sum;
+                high[j] = reduceMontgomery(prime, (uint64_t) difference * roots[half + j]);
+            }
+        }
+    }
+}
+
+/**
+ * Transform values in bit reversed order back in place, with the butterflies of decimation in time, except
+ * for the division by their amount. The inverse roots come from the same table, as a primitive 2 * half:th
+ * root of unity w has w^-j = -w^(half - j).
+ *
+ * @param prime The prime
+ * @param values The transformed values
+ * @param length The amount of values, a power of 2
+ * @param roots The roots of unity, in Montgomery form
+ */
+void inverseTransformNtt(const NttPrime *prime, uint32_t *values, size_t length, const uint32_t *roots)
+{
+    uint32_t modulus = prime->modulus;
+    for (size_t half = 1; half < length; half *= 2) {
+        for (size_t start = 0; start < length; start += 2 * half) {
+            uint32_t *low = values + start;
+            uint32_t *high = values + start + half;
+            uint32_t sum = low[0] + high[0];
+            uint32_t difference = low[0] + modulus - high[0];
+            low[0] = sum >= modulus ? sum - modulus : sum;
+            high[0] = difference >= modulus ? difference - modulus : difference;
+            for (size_t j = 1; j < half; ++j) {
+                uint32_t product = reduceMontgomery(prime, (uint64_t) high[j] * roots[2 * half - j]);
+                sum = low[j] + product;
+                difference = low[j] + modulus - product;
+                low[j] = difference >= modulus ? difference - modulus : difference;
+                high[j] = sum >= modulus ? sum - modulus : sum;
+            }
+        }
+    }
+}
+
+/**
+ * Compute the constants of Montgomery multiplication modulo a prime.
+ *
+ * @param prime The prime
+ */
+void initializeNttPrime(NttPrime *prime)
+{
+    /* Newton's iteration doubles the correct low bits of the inverse of the odd modulus each step */
+    uint32_t inverse = prime->modulus;
+    for (int i = 0; i < 5; ++i) {
+        inverse *= 2 - prime->modulus * inverse;
+    }
+    prime->negatedInverse = -inverse;
+    uint64_t montgomery = ((uint64_t) 1 << 32) % prime->modulus;
+    prime->montgomerySquare = (uint32_t) (montgomery * montgomery % prime->modulus);
+}
+
+/**
+ * Divide a value by 2^32 modulo a prime.
+ *
+ * @param prime The prime
+ * @param value The value, below the prime times 2^32
+ * @return The quotient, below the prime
+ */
+uint32_t reduceMontgomery(const NttPrime *prime, uint64_t value)
+{
+    uint32_t multiple = (uint32_t) value * prime->negatedInverse;
+    uint32_t quotient = (uint32_t) ((value + (uint64_t) multiple * prime->modulus) >> 32);
+
+    return quotient >= prime->modulus ? quotient - prime->modulus : quotient;
+}
+
+/**
+ * Raise a number to a power modulo a number.
+ *
+ * @param base The number, below the modulus
+ * @param exponent The power
+ * @param modulus The modulus, below 2^32
+ * @return The number to the power modulo the modulus
+ */
+uint32_t powerModulo(uint32_t base, uint64_t exponent, uint32_t modulus)
+{
+    uint64_t result = 1;
+    uint64_t square = base;
+    while (exponent > 0) {
+        if (exponent & 1) {
+            result = result * square % modulus;
+        }
+        square = square * square % modulus;
+        exponent >>= 1;
+    }
+
+    return (uint32_t) result;
+}
+
+/**
+ * Add a number to another in place.
+ *
+ * @param sum The limbs of the number added to
+ * @param sumLength The amount of limbs of the number added to
+ * @param addend The limbs of the added number
+ * @param addendLength The amount of limbs of the added number, at most sumLength
+ * @return The carry out of the last limb
+ */
+uint32_t addLimbs(uint32_t *sum, size_t sumLength, const uint32_t *addend, size_t addendLength)
+{
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < addendLength; ++i) {
+        carry += (uint64_t) sum[i] + addend[i];
+        sum[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    for (; carry != 0 && i < sumLength; ++i) {
+        carry += sum[i];
+        sum[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+
+    return (uint32_t) carry;
+}
+
+/**
+ * Subtract a number from a larger one in place.
+ *
+ * @param difference The limbs of the number subtracted from
+ * @param differenceLength The amount of limbs of the number subtracted from
+ * @param subtrahend The limbs of the subtracted number
+ * @param subtrahendLength The amount of limbs of the subtracted number, at most differenceLength
+ */
+void subtractLimbs(uint32_t *difference, size_t differenceLength, const uint32_t *subtrahend,
+                   size_t subtrahendLength)
+{
+    uint32_t borrow = 0;
+    size_t i = 0;
+    for (; i < subtrahendLength; ++i) {
+        uint64_t subtracted = (uint64_t) subtrahend[i] + borrow;
+        borrow = difference[i] < subtracted;
+        difference[i] = (uint32_t) (difference[i] - subtracted);
+    }
+    for (; borrow != 0 && i < differenceLength; ++i) {
+        borrow = difference[i] == 0;
+        difference[i]--;
+    }
+}
+
+/**
+ * Count the limbs of a number without its leading zero limbs.
+ *
+ * @param limbs The limbs
+ * @param length The amount of limbs
+ * @return The amount of limbs up to the most significant limb that is not zero
+ */
+size_t normalizedLength(const uint32_t *limbs, size_t length)
+{
+    while (length > 0 && limbs[length - 1] == 0) {
+        length--;
+    }
+
+    return length;
+}
+
+/**
+ * Multiply a number by a limb into a new number.
+ *
+ * @param number The number
+ * @param factor The limb
+ * @return The product, whose limbs are allocated
+ */
+BigNumber multiplyBySmall(const BigNumber *number, uint32_t factor)
+{
+    BigNumber product = { malloc((number->length + 1) * sizeof(uint32_t)), 0 };
+    if (product.limbs == NULL) {
+        printf("Error: malloc failed in multiplyBySmall\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t carry = 0;
+    for (size_t i = 0; i < number->length; ++i) {
+        carry += (uint64_t) number->limbs[i] * factor;
+        product.limbs[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    product.limbs[number->length] = (uint32_t) carry;
+    product.length = normalizedLength(product.limbs, number->length + 1);
+
+    return product;
+}
+
+/**
+ * Add a number to a number with allocated limbs.
+ *
+ * @param sum The number added to, whose limbs are reallocated
+ * @param addend The added number
+ */
+void addBigNumber(BigNumber *sum, const BigNumber *addend)
+{
+    size_t length = (sum->length > addend->length ? sum->length : addend->length) + 1;
+    sum->limbs = realloc(sum->limbs, length * sizeof(uint32_t));
+    if (sum->limbs == NULL) {
+        printf("Error: realloc failed in addBigNumber\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(sum->limbs + sum->length, 0, (length - sum->length) * sizeof(uint32_t));
+    addLimbs(sum->limbs, length, addend->limbs, addend->length);
+    sum->length = normalizedLength(sum->limbs, length);
+}
+
+/**
+ * Print the digits of a number that were asked for on a line of their own, with one write: all of them,
+ * their amount, or the first and the last of them.
+ *
+ * @param number The number
+ */
+void printBigNumberLine(const BigNumber *number)
+{
+    TextBuffer output;
+    if (printDigitCount) {
+        createTextBuffer(&output, 32, STDOUT_FILENO);
+        output.length = (size_t) sprintf(output.text, "%zu\n", countDecimalDigits(number));
+        flushText(&output);
+        free(output.text);
+        return;
+    }
+
+    createTextBuffer(&output, number->length * 10 + 8, STDOUT_FILENO);
+    appendBigNumber(&output, number);
+    size_t digitCount = output.length;
+    if ((leadingDigitCount > 0 || trailingDigitCount > 0) && leadingDigitCount + trailingDigitCount < digitCount) {
+        /* The last digits are moved down after the first, with dots between them if both are printed */
+        size_t separatorLength = leadingDigitCount > 0 && trailingDigitCount > 0 ? 3 : 0;
+        memmove(output.text + leadingDigitCount + separatorLength, output.text + digitCount - trailingDigitCount,
+                trailingDigitCount);
+        memcpy(output.text + leadingDigitCount, "...", separatorLength);
+        output.length = leadingDigitCount + separatorLength + trailingDigitCount;
+    }
+    appendText(&output, "\n", 1);
+    flushText(&output);
+    free(output.text);
+}
+
+/**
+ * Format a number in decimal. Large numbers are split by a cached power of 10 into a high and a low half,
+ * which are formatted the same way, so the conversion costs a few multiplications of the size of the
+ * number at each of the logarithmically many levels instead of a quadratic amount of divisions.
+ *
+ * @param number The number
+ * @param digits Room for the digits, which are at most 10 per limb, or 1 for zero. They are not terminated
+ * @return The amount of digits
+ */
+size_t formatBigNumber(const BigNumber *number, char *digits)
+{
+    if (number->length <= DECIMAL_BASECASE_LIMBS) {
+        return formatLimbs(number->limbs, number->length, digits, 0);
+    }
+
+    int level = prepareDecimalPowers(number->length);
+    size_t mark = conversionArena.used;
+    size_t digitCount = writeDecimal(number->limbs, number->length, level, digits, false);
+    conversionArena.used = mark;
+
+    return digitCount;
+}
+
+/**
+ * Count the decimal digits of a number. Only the high halves of the splits are formatted.
+ *
+ * @param number The number
+ * @return The amount of digits
+ */
+size_t countDecimalDigits(const BigNumber *number)
+{
+    const uint32_t *limbs = number->limbs;
+    size_t length = number->length;
+    size_t digitCount = 0;
+    int level = length > DECIMAL_BASECASE_LIMBS ? prepareDecimalPowers(length) : 0;
+    size_t mark = conversionArena.used;
+    while (length > DECIMAL_BASECASE_LIMBS) {
+        const BigNumber *power = &decimalPowers.powers[level];
+        if (compareLimbs(limbs, length, power->limbs, power->length) < 0) {
+            level--;
+            continue;
+        }
+        BigNumber quotient;
+        BigNumber remainder;
+        divideByDecimalPower(limbs, length, level, &quotient, &remainder);
+        digitCount += (size_t) 9 << level;
+        limbs = quotient.limbs;
+        length = quotient.length;
+    }
+
+    char lastDigits[DECIMAL_BASECASE_LIMBS * 10 + 1];
+    digitCount += formatLimbs(limbs, length, lastDigits, 0);
+    conversionArena.used = mark;
+
+    return digitCount;
+}
+
+/**
+ * Write a number in decimal. A number padded with leading zeros is below the square of the power it is
+ * split by, so both halves are padded numbers of the level below. An unpadded number may be larger, and then
+ * its high half is split by the same power again.
+ *
+ * @param limbs The limbs of the number
+ * @param length The amount of limbs
+ * @param level The index of the power the number is split by, which is 10^(9 * 2^level)
+ * @param digits Room for the digits, which are not terminated
+ * @param padded Pad the number with leading zeros to 18 * 2^level digits
+ * @return The amount of digits
+ */
+size_t writeDecimal(const uint32_t *limbs, size_t length, int level, char *digits, bool padded)
+{
+    length = normalizedLength(limbs, length);
+    size_t width = padded ? (size_t) 18 << level : 0;
+    if (length <= DECIMAL_BASECASE_LIMBS) {
+        return formatLimbs(limbs, length, digits, width);
+    }
+
+    const BigNumber *power = &decimalPowers.powers[level];
+    if (!padded && compareLimbs(limbs, length, power->limbs, power->length) < 0) {
+        return writeDecimal(limbs, length, level - 1, digits, false);
+    }
+
+    size_t mark = conversionArena.used;
+    BigNumber quotient;
+    BigNumber remainder;
+    divideByDecimalPower(limbs, length, level, &quotient, &remainder);
+    size_t digitCount = writeDecimal(quotient.limbs, quotient.length, padded ? level - 1 : level, digits, padded);
+    digitCount += writeDecimal(remainder.limbs, remainder.length, level - 1, digits + digitCount, true);
+    conversionArena.used = mark;
+
+    return digitCount;
+}
+
+/**
+ * Format a small number in decimal, by dividing it by 10^9 repeatedly.
+ *
+ * @param limbs The limbs of the number
+ * @param length The amount of limbs, at most DECIMAL_BASECASE_LIMBS
+ * @param digits Room for the digits, which are not terminated
+ * @param width The amount of digits to pad the number to with leading zeros, or 0 for no padding
+ * @return The amount of digits
+ */
+size_t formatLimbs(const uint32_t *limbs, size_t length, char *digits, size_t width)
+{
+    uint32_t quotient[DECIMAL_BASECASE_LIMBS];
+    uint32_t chunks[DECIMAL_BASECASE_LIMBS * 32 / 29 + 2];
+    memcpy(quotient, limbs, length * sizeof(uint32_t));
+    length = normalizedLength(quotient, length);
+
+    size_t chunkCount = 0;
+    do {
+        uint64_t remainder = 0;
+        for (size_t i = length; i-- > 0;) {
+            remainder = remainder << 32 | quotient[i];
+            quotient[i] = (uint32_t) (remainder / 1000000000);
+            remainder %= 1000000000;
+        }
+        chunks[chunkCount++] = (uint32_t) remainder;
+        length = normalizedLength(quotient, length);
+    } while (length > 0);
+
+    char first[10];
+    size_t firstLength = (size_t) sprintf(first, "%u", chunks[chunkCount - 1]);
+    size_t digitCount = firstLength + 9 * (chunkCount - 1);
+    size_t padding = width > digitCount ? width - digitCount : 0;
+    memset(digits, '0', padding);
+    memcpy(digits + padding, first, firstLength);
+    digitCount = padding + firstLength;
+    for (size_t i = chunkCount - 1; i-- > 0;) {
+        uint32_t chunk = chunks[i];
+        for (int j = 8; j >= 0; --j) {
+            digits[digitCount + j] = (char) ('0' + chunk % 10);
+            chunk /= 10;
+        }
+        digitCount += 9;
+    }
+
+    return digitCount;
+}
+
+/**
+ * Cache the powers of 10 that a number needs to be formatted, with their reciprocals, and make the
+ * conversion arena large enough for it.
+ *
+ * @param length The amount of limbs of the number
+ * @return The index of the largest power of at most half the limbs of the number
+ */
+int prepareDecimalPowers(size_t length)
+{
+    if (conversionArena.capacity - conversionArena.used < 48 * length + 65536) {
+        free(conversionArena.limbs);
+        createLimbArena(&conversionArena, 48 * length + 65536);
+    }
+
+    if (decimalPowers.count == 0) {
+        /* 10^9 is one limb, and its reciprocal 2^64 / 10^9 is two */
+        uint32_t *power = malloc(sizeof(uint32_t));
+        uint32_t *reciprocal = malloc(2 * sizeof(uint32_t));
+        if (power == NULL || reciprocal == NULL) {
+            printf("Error: malloc failed in prepareDecimalPowers\n");
+            exit(EXIT_FAILURE);
+        }
+        uint64_t quotient = UINT64_MAX / 1000000000;
+        power[0] = 1000000000;
+        reciprocal[0] = (uint32_t) quotient;
+        reciprocal[1] = (uint32_t) (quotient >> 32);
+        decimalPowers.powers[0] = (BigNumber) { power, 1 };
+        decimalPowers.reciprocals[0] = (BigNumber) { reciprocal, 2 };
+        decimalPowers.count = 1;
+        initializeNttPrime(&nttPrimes[0]);
+        initializeNttPrime(&nttPrimes[1]);
+    }
+
+    /* The square of a power of k limbs has 2k - 1 or 2k limbs */
+    while (2 * decimalPowers.powers[decimalPowers.count - 1].length - 1 <= (length + 1) / 2) {
+        addDecimalPower();
+    }
+    int level = decimalPowers.count - 1;
+    while (level > 0 && decimalPowers.powers[level].length > (length + 1) / 2) {
+        level--;
+    }
+
+    return level;
+}
+
+/**
+ * Cache the square of the largest cached power of 10, and its reciprocal floor(2^(64k) / power), where k is
+ * the amount of limbs of the power. The reciprocal starts from the square of the reciprocal of the
+ * previous power, which is below the new reciprocal, and gets exact after two Newton steps and a few
+ * corrections. Newton steps from below stay below, so every difference is positive.
+ */
+void addDecimalPower(void)
+{
+    LimbArena *arena = &conversionArena;
+    size_t mark = arena->used;
+    const BigNumber *previous = &decimalPowers.powers[decimalPowers.count - 1];
+    const BigNumber *previousReciprocal = &decimalPowers.reciprocals[decimalPowers.count - 1];
+
+    size_t length = 2 * previous->length;
+    uint32_t *power = malloc(length * sizeof(uint32_t));
+    if (power == NULL) {
+        printf("Error: malloc failed in addDecimalPower\n");
+        exit(EXIT_FAILURE);
+    }
+    multiplyLimbs(arena, previous->limbs, previous->length, previous->limbs, previous->length, power);
+    length = normalizedLength(power, length);
+
+    /* The square of the previous reciprocal is scaled by 2^(64 * previous length), which is dropped */
+    size_t reciprocalLength = 2 * previousReciprocal->length;
+    uint32_t *square = allocateLimbs(arena, reciprocalLength);
+    multiplyLimbs(arena, previousReciprocal->limbs, previousReciprocal->length, previousReciprocal->limbs,
+                  previousReciprocal->length, square);
+    size_t shift = 4 * previous->length - 2 * length;
+    size_t capacity = length + 3;
+    uint32_t *reciprocal = malloc(capacity * sizeof(uint32_t));
+    if (reciprocal == NULL) {
+        printf("Error: malloc failed in addDecimalPower\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(reciprocal, 0, capacity * sizeof(uint32_t));
+    size_t squareLength = normalizedLength(square, reciprocalLength);
+    memcpy(reciprocal, square + shift, (squareLength - shift) * sizeof(uint32_t));
+    arena->used = mark;
+
+    uint32_t *error = allocateLimbs(arena, 2 * length + 1);
+    uint32_t *product = allocateLimbs(arena, length + capacity);
+    for (int step = 0; step < 2; ++step) {
+        /* x += x * (2^(64k) - power * x) / 2^(64k) */
+        size_t currentLength = normalizedLength(reciprocal, capacity);
+        size_t errorLength = computeReciprocalError(power, length, reciprocal, currentLength, error, product);
+        if (errorLength == 0) {
+            break;
+        }
+        size_t stepMark = arena->used;
+        uint32_t *correction = allocateLimbs(arena, currentLength + errorLength);
+        multiplyLimbs(arena, reciprocal, currentLength, error, errorLength, correction);
+        size_t correctionLength = normalizedLength(correction, currentLength + errorLength);
+        if (correctionLength > 2 * length) {
+            addLimbs(reciprocal, capacity, correction + 2 * length, correctionLength - 2 * length);
+        }
+        arena->used = stepMark;
+    }
+
+    size_t errorLength = computeReciprocalError(power, length, reciprocal, normalizedLength(reciprocal, capacity),
+                                                error, product);
+    while (compareLimbs(error, errorLength, power, length) >= 0) {
+        uint32_t one = 1;
+        addLimbs(reciprocal, capacity, &one, 1);
+        subtractLimbs(error, errorLength, power, length);
+        errorLength = normalizedLength(error, errorLength);
+    }
+    arena->used = mark;
+
+    int count = decimalPowers.count++;
+    decimalPowers.powers[count] = (BigNumber) { power, length };
+    decimalPowers.reciprocals[count] = (BigNumber) { reciprocal, normalizedLength(reciprocal, capacity) };
+}
+
+/**
+ * Compute how far an underestimate of the reciprocal of a power of 10 is from exact, as
+ * 2^(64k) - power * reciprocal, where k is the amount of limbs of the power.
+ *
+ * @param power The limbs of the power
+ * @param length The amount of limbs of the power
+ * @param reciprocal The limbs of the reciprocal
+ * @param reciprocalLength The amount of limbs of the reciprocal, at most length + 3
+ * @param error The 2 * length + 1 limbs of the difference
+ * @param product Room for the product of the power and the reciprocal
+ * @return The amount of limbs of the difference
+ */
+size_t computeReciprocalError(const uint32_t *power, size_t length, const uint32_t *reciprocal,
+                              size_t reciprocalLength, uint32_t *error, uint32_t *product)
+{
+    multiplyLimbs(&conversionArena, power, length, reciprocal, reciprocalLength, product);
+    memset(error, 0, (2 * length + 1) * sizeof(uint32_t));
+    error[2 * length] = 1;
+    subtractLimbs(error, 2 * length + 1, product, normalizedLength(product, length + reciprocalLength));
+
+    return normalizedLength(error, 2 * length + 1);
+}
+
+/**
+ * Divide a number by a cached power of 10 of k limbs. A number of more than 2k limbs is divided like on
+ * paper, in digits of k limbs, so each division is of a number below 2^(64k). The quotient and remainder
+ * are allocated from the conversion arena, where they stay.
+ *
+ * @param limbs The limbs of the number
+ * @param length The amount of limbs of the number
+ * @param level The index of the power
+ * @param quotient The quotient
+ * @param remainder The remainder
+ */
+void divideByDecimalPower(const uint32_t *limbs, size_t length, int level, BigNumber *quotient,
+                          BigNumber *remainder)
+{
+    LimbArena *arena = &conversionArena;
+    size_t powerLength = decimalPowers.powers[level].length;
+    uint32_t *quotientLimbs = allocateLimbs(arena, length + 1);
+    uint32_t *remainderLimbs = allocateLimbs(arena, 2 * powerLength + 1);
+    memset(quotientLimbs, 0, (length + 1) * sizeof(uint32_t));
+    size_t mark = arena->used;
+
+    size_t chunkCount = length > 2 * powerLength ? (length - 2 * powerLength + powerLength - 1) / powerLength : 0;
+    size_t offset = chunkCount * powerLength;
+    size_t dividendLength = length - offset;
+    memcpy(remainderLimbs, limbs + offset, dividendLength * sizeof(uint32_t));
+    size_t remainderLength = divideByBarrett(remainderLimbs, dividendLength, level, quotientLimbs + offset);
+    while (offset > 0) {
+        /* The remainder is below the power, so with the next digit it is below 2^(32k) times the power */
+        offset -= powerLength;
+        memmove(remainderLimbs + powerLength, remainderLimbs, remainderLength * sizeof(uint32_t));
+        memcpy(remainderLimbs, limbs + offset, powerLength * sizeof(uint32_t));
+        remainderLength = divideByBarrett(remainderLimbs, powerLength + remainderLength, level,
+                                          quotientLimbs + offset);
+    }
+    arena->used = mark;
+
+    *quotient = (BigNumber) { quotientLimbs, normalizedLength(quotientLimbs, length + 1) };
+    *remainder = (BigNumber) { remainderLimbs, remainderLength };
+}
+
+/**
+ * Divide a number below 2^(64k) by a cached power of 10 of k limbs in place, with Barrett's method, which
+ * estimates the quotient with the reciprocal of the power to within 2 below it.
+ *
+ * @param number The limbs of the number, which are replaced by the remainder
+ * @param length The amount of limbs of the number, at most 2k
+ * @param level The index of the power
+ * @param quotient Where the quotient is added, which has room for length - k + 1 limbs and is zero there
+ * @return The amount of limbs of the remainder
+ */
+size_t divideByBarrett(uint32_t *number, size_t length, int level, uint32_t *quotient)
+{
+    LimbArena *arena = &conversionArena;
+    const BigNumber *power = &decimalPowers.powers[level];
+    const BigNumber *reciprocal = &decimalPowers.reciprocals[level];
+    size_t powerLength = power->length;
+    length = normalizedLength(number, length);
+    if (compareLimbs(number, length, power->limbs, powerLength) < 0) {
+        return length;
+    }
+    size_t mark = arena->used;
+
+    /* q = floor(floor(x / 2^(32 (k - 1))) * reciprocal / 2^(32 (k + 1))) */
+    size_t highLength = length - (powerLength - 1);
+    uint32_t *estimate = allocateLimbs(arena, highLength + reciprocal->length);
+    multiplyLimbs(arena, number + powerLength - 1, highLength, reciprocal->limbs, reciprocal->length, estimate);
+    size_t estimateLength = normalizedLength(estimate, highLength + reciprocal->length);
+    size_t quotientLength = estimateLength > powerLength + 1 ? estimateLength - (powerLength + 1) : 0;
+    memcpy(quotient, estimate + powerLength + 1, quotientLength * sizeof(uint32_t));
+
+    if (quotientLength > 0) {
+        uint32_t *product = allocateLimbs(arena, quotientLength + powerLength);
+        multiplyLimbs(arena, quotient, quotientLength, power->limbs, powerLength, product);
+        subtractLimbs(number, length, product, normalizedLength(product, quotientLength + powerLength));
+    }
+    length = normalizedLength(number, length);
+    while (compareLimbs(number, length, power->limbs, powerLength) >= 0) {
+        uint32_t one = 1;
+        subtractLimbs(number, length, power->limbs, powerLength);
+        length = normalizedLength(number, length);
+        addLimbs(quotient, highLength + 1, &one, 1);
+    }
+    arena->used = mark;
+
+    return length;
+}
+
+/**
+ * Compare two numbers.
+ *
+ * @param a The limbs of the first number
+ * @param aLength The amount of limbs of the first number
+ * @param b The limbs of the second number
+ * @param bLength The amount of limbs of the second number
+ * @return Negative, zero or positive like strcmp
+ */
+int compareLimbs(const uint32_t *a, size_t aLength, const uint32_t *b, size_t bLength)
+{
+    aLength = normalizedLength(a, aLength);
+    bLength = normalizedLength(b, bLength);
+    if (aLength != bLength) {
+        return aLength < bLength ? -1 : 1;
+    }
+    for (size_t i = aLength; i-- > 0;) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Allocate a text buffer.
+ *
+ * @param buffer The buffer
+ * @param capacity The size of the buffer
+ * @param fileDescriptor The file the buffer is written to, or -1 for a buffer that grows
+ */
+void createTextBuffer(TextBuffer *buffer, size_t capacity, int fileDescriptor)
+{
+    buffer->text = malloc(capacity);
+    if (buffer->text == NULL) {
+        printf("Error: malloc failed in createTextBuffer\n");
+        exit(EXIT_FAILURE);
+    }
+    buffer->length = 0;
+    buffer->capacity = capacity;
+    buffer->fileDescriptor = fileDescriptor;
+}
+
+/**
+ * Make room at the end of a text buffer, by writing it out or by growing it.
+ *
+ * @param buffer The buffer
+ * @param extra The size of the room
+ * @return The room, which is added to the text by adding to the length of the buffer
+ */
+char *reserveText(TextBuffer *buffer, size_t extra)
+{
+    if (extra > buffer->capacity - buffer->length && buffer->fileDescriptor >= 0) {
+        flushText(buffer);
+    }
+    if (extra > buffer->capacity - buffer->length) {
+        size_t capacity = buffer->capacity * 2;
+        while (capacity - buffer->length < extra) {
+            capacity *= 2;
+        }
+        buffer->text = realloc(buffer->text, capacity);
+        if (buffer->text == NULL) {
+            printf("Error: realloc failed in reserveText\n");
+            exit(EXIT_FAILURE);
+        }
+        buffer->capacity = capacity;
+    }
+
+    return buffer->text + buffer->length;
+}
+
+/**
+ * Append text to a text buffer. Text larger than a buffer with a file is written to the file directly.
+ *
+ * @param buffer The buffer
+ * @param text The text
+ * @param length The length of the text
+ */
+void appendText(TextBuffer *buffer, const char *text, size_t length)
+{
+    if (buffer->fileDescriptor >= 0 && length > buffer->capacity - buffer->length) {
+        flushText(buffer);
+        if (length >= buffer->capacity) {
+            TextBuffer direct = { (char *) text, length, length, buffer->fileDescriptor };
+            flushText(&direct);
+            return;
+        }
+    }
+
+    memcpy(reserveText(buffer, length), text, length);
+    buffer->length += length;
+}
+
+/**
+ * Append a number in decimal to a text buffer.
+ *
+ * @param buffer The buffer
+ * @param number The number
+ */
+void appendBigNumber(TextBuffer *buffer, const BigNumber *number)
+{
+    char *digits = reserveText(buffer, number->length * 10 + 1);
+    buffer->length += formatBigNumber(number, digits);
+}
+
+/**
+ * Write the text of a buffer to its file and empty the buffer.
+ *
+ * @param buffer The buffer
+ */
+void flushText(TextBuffer *buffer)
+{
+    size_t written = 0;
+    while (written < buffer->length) {
+        ssize_t bytesWritten = write(buffer->fileDescriptor, buffer->text + written, buffer->length - written);
+        if (bytesWritten < 0) {
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+        written += bytesWritten;
+    }
+    buffer->length = 0;
+}